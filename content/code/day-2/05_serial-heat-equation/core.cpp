@@ -58,3 +58,91 @@ evolve(field *curr, field *prev, double a, double dt)
     }
   }
 }
+
+// Apply the five-point Laplacian to the field u at linear index ind
+// Arguments:
+//   u: field values
+//   ind: linear index of the point
+//   ld: leading dimension of the field, including the ghost layers
+//   dx2, dy2: squared grid spacings
+static inline double
+laplacian(const double *u, int ind, int ld, double dx2, double dy2)
+{
+  return (u[ind + ld] - 2.0 * u[ind] + u[ind - ld]) / dx2 +
+         (u[ind + 1] - 2.0 * u[ind] + u[ind - 1]) / dy2;
+}
+
+// Advance the temperature values by one super-step of the second-order
+// Runge-Kutta-Legendre (RKL2) super-time-stepping scheme, see Meyer, Balsara
+// and Aslam, J. Comput. Phys. 257 (2014) 594-626.
+// A super-step with s stages applies the five-point stencil s times and is
+// stable for time steps up to (s^2 + s - 2) / 4 times the explicit limit.
+// Arguments:
+//   curr: temperature values after the super-step
+//   prev: temperature values before the super-step
+//   work: scratch field with the same dimensions and boundary values
+//   a: diffusivity
+//   dt: super-step
+//   nstages: number of stages s, at least 2
+void
+evolve_rkl2(
+  field *curr,
+  field *prev,
+  field *work,
+  double a,
+  double dt,
+  int nstages)
+{
+  const int nx = curr->nx;
+  const int ny = curr->ny;
+  const int ld = ny + 2;
+
+  double dx2 = prev->dx * prev->dx;
+  double dy2 = prev->dy * prev->dy;
+
+  const int s      = nstages;
+  const double w1 = 4.0 / (s * s + s - 2);
+  // coefficients b_j of the scheme
+  auto b = [](int j) {
+    return j < 2 ? 1.0 / 3.0 : (j * j + j - 2.0) / (2.0 * j * (j + 1.0));
+  };
+
+  // The stages are written alternately to the two output arrays, such that
+  // the last stage ends up in curr. A stage only reads the stage two steps
+  // before at the point it is writing, so it can overwrite it.
+  const double *y0 = prev->data.data();
+  double *odd      = (s % 2 == 1) ? curr->data.data() : work->data.data();
+  double *even     = (s % 2 == 1) ? work->data.data() : curr->data.data();
+
+  // first stage
+  const double mu1 = b(1) * w1;
+  for (int i = 1; i < nx + 1; i++) {
+    for (int j = 1; j < ny + 1; j++) {
+      int ind  = i * ld + j;
+      odd[ind] = y0[ind] + mu1 * dt * a * laplacian(y0, ind, ld, dx2, dy2);
+    }
+  }
+
+  // remaining stages
+  for (int k = 2; k <= s; k++) {
+    const double mu    = (2.0 * k - 1.0) / k * b(k) / b(k - 1);
+    const double nu    = -(k - 1.0) / k * b(k) / b(k - 2);
+    const double mu_t  = mu * w1;
+    const double gamma = -(1.0 - b(k - 1)) * mu_t;
+
+    double *yk         = (k % 2 == 1) ? odd : even;
+    const double *ykm1 = (k % 2 == 1) ? even : odd;
+    // the stage two steps before the first stage is the initial state
+    const double *ykm2 = (k == 2) ? y0 : yk;
+
+    for (int i = 1; i < nx + 1; i++) {
+      for (int j = 1; j < ny + 1; j++) {
+        int ind = i * ld + j;
+        yk[ind] = mu * ykm1[ind] + nu * ykm2[ind] + (1.0 - mu - nu) * y0[ind] +
+                  dt * a *
+                    (mu_t * laplacian(ykm1, ind, ld, dx2, dy2) +
+                     gamma * laplacian(y0, ind, ld, dx2, dy2));
+      }
+    }
+  }
+}
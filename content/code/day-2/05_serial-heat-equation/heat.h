@@ -56,12 +56,24 @@ initialize(
 void
 generate_field(field *temperature);
 
+int
+parameter_from_env(const char *name, int fallback);
+
 double
 average(field *temperature);
 
 void
 evolve(field *curr, field *prev, double a, double dt);
 
+void
+evolve_rkl2(
+  field *curr,
+  field *prev,
+  field *work,
+  double a,
+  double dt,
+  int nstages);
+
 void
 write_field(field *temperature, int iter);
 
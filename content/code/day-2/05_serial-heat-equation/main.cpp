@@ -22,6 +22,7 @@
 // Main routine for heat equation solver in 2D.
 
 #include <chrono>
+#include <cmath>
 #include <cstdio>
 
 #include "heat.h"
@@ -55,17 +56,47 @@ main(int argc, char **argv)
 
   using wall_clock_t = std::chrono::high_resolution_clock;
 
+  // Number of stages of the RKL2 super-time-stepping integrator. With 2 or
+  // more stages, the explicit steps are replaced by super-steps covering the
+  // same simulated time.
+  int nstages = parameter_from_env("HEAT_STAGES", 0);
+
   auto start = wall_clock_t::now();
 
-  // Time evolution
-  for (int iter = 1; iter <= nsteps; iter++) {
-    evolve(&current, &previous, a, dt);
-    if (iter % image_interval == 0) {
-      write_field(&current, iter);
+  if (nstages < 2) {
+    // Time evolution
+    for (int iter = 1; iter <= nsteps; iter++) {
+      evolve(&current, &previous, a, dt);
+      if (iter % image_interval == 0) {
+        write_field(&current, iter);
+      }
+      // Swap current field so that it will be used
+      // as previous for next iteration step
+      swap_fields(&current, &previous);
+    }
+  } else {
+    // Largest stable super-step and number of super-steps needed to cover
+    // nsteps explicit time steps
+    double dt_max = dt * (nstages * nstages + nstages - 2) / 4.0;
+    int nsupersteps =
+      static_cast<int>(std::ceil(nsteps * dt / dt_max - 1.0e-12));
+    double dt_super = nsteps * dt / nsupersteps;
+
+    // Scratch field for the stages, with the same boundary values
+    field work = previous;
+
+    // Time evolution
+    for (int iter = 1; iter <= nsupersteps; iter++) {
+      evolve_rkl2(&current, &previous, &work, a, dt_super, nstages);
+      // Swap current field so that it will be used
+      // as previous for next iteration step
+      swap_fields(&current, &previous);
     }
-    // Swap current field so that it will be used
-    // as previous for next iteration step
-    swap_fields(&current, &previous);
+    printf(
+      "Took %d super-steps of %d stages instead of %d time steps.\n",
+      nsupersteps,
+      nstages,
+      nsteps);
   }
 
   auto stop = wall_clock_t::now();
@@ -147,3 +147,15 @@ set_field_dimensions(field *temperature, int nx, int ny)
   temperature->nx = nx;
   temperature->ny = ny;
 }
+
+/* Read an integer tuning parameter from the environment variable name.
+ * The fallback value is returned if the variable is not set. */
+int
+parameter_from_env(const char *name, int fallback)
+{
+  const char *value = getenv(name);
+  if (value == nullptr) {
+    return fallback;
+  }
+  return atoi(value);
+}
@@ -0,0 +1,188 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Heat equation solver that skips the tiles of the grid that have reached
+// equilibrium, so that the work follows the active regions
+
+#include <sycl/sycl.hpp>
+
+#include "heat.h"
+
+using namespace sycl;
+
+// States of a tile for the next time step
+enum tile_state : uint8_t
+{
+  // the tile is skipped, and curr and prev hold the same values in it
+  tile_inactive,
+  // the tile is updated
+  tile_active,
+  // the tile was updated on the last time step but is skipped from now on.
+  // Its values in prev are copied to curr once, so that both fields hold
+  // the latest values from then on.
+  tile_deactivated
+};
+
+// Set up the activity flags for tiles of the given size over the interior
+// of a field. All the tiles start active.
+void
+allocate_active_tiles(
+  const field *layout,
+  range<2> tile,
+  double epsilon,
+  active_tiles *tiles)
+{
+  tiles->ty      = tile[0];
+  tiles->tx      = tile[1];
+  tiles->nty     = (layout->nx + tiles->ty - 1) / tiles->ty;
+  tiles->ntx     = (layout->ny + tiles->tx - 1) / tiles->tx;
+  tiles->epsilon = epsilon;
+
+  const int ntiles = tiles->nty * tiles->ntx;
+  tiles->active.assign(ntiles, tile_active);
+  tiles->change.assign(ntiles, 0.0);
+  tiles->computed.assign(1, 0);
+}
+
+// Update the temperature values using five-point stencil in the active
+// tiles only, with the fields held in USM allocations the device can access.
+// Each work-group updates one tile, or returns straight away if the tile is
+// inactive, and records the largest change in its tile. A second kernel then
+// activates the tiles where the change, or the change in one of the
+// neighbouring tiles, was at least epsilon.
+// A tile is frozen at its latest values, which changed by less than epsilon
+// on the last time step. This is not a bound on the error: the skipped
+// updates accumulate for as long as the tile stays inactive, each of them
+// below epsilon only while the changes around the tile stay below epsilon.
+// Arguments:
+//   curr: current temperature values
+//   prev: temperature values from previous time step
+//   layout: field with the dimensions and row layout of the arrays
+//   a: diffusivity
+//   dt: time step
+//   tiles: activity of the tiles
+void
+evolve_active(
+  queue &Q,
+  double *curr,
+  const double *prev,
+  const field *layout,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  active_tiles *tiles)
+{
+  // leading dimension of the fields
+  const int ld = layout->pitch;
+
+  const int nx     = layout->nx;
+  const int ny     = layout->ny;
+  const int offset = layout->offset;
+
+  // Help the compiler avoid being confused by the structs
+  const int ty         = tiles->ty;
+  const int tx         = tiles->tx;
+  const int nty        = tiles->nty;
+  const int ntx        = tiles->ntx;
+  const double epsilon = tiles->epsilon;
+  uint8_t *active      = tiles->active.data();
+  double *change       = tiles->change.data();
+
+  range global { static_cast<size_t>(nty * ty),
+                 static_cast<size_t>(ntx * tx) };
+  range tile { static_cast<size_t>(ty), static_cast<size_t>(tx) };
+
+  Q.parallel_for(nd_range { global, tile }, [=](nd_item<2> it) {
+    const int t = it.get_group(0) * ntx + it.get_group(1);
+
+    const int j = it.get_global_id(0) + 1;
+    const int i = it.get_global_id(1) + 1;
+    const int c = j * ld + offset + i;
+
+    // the whole work-group returns together, before any group operation
+    if (active[t] != tile_active) {
+      if (active[t] == tile_deactivated && j <= nx && i <= ny) {
+        curr[c] = prev[c];
+      }
+      if (it.get_local_linear_id() == 0) {
+        change[t] = 0.0;
+      }
+      return;
+    }
+
+    double delta = 0.0;
+    if (j <= nx && i <= ny) {
+      curr[c] =
+        prev[c] +
+        a * dt *
+          ((prev[c + 1] - 2.0 * prev[c] + prev[c - 1]) / dx2 +
+           (prev[c + ld] - 2.0 * prev[c] + prev[c - ld]) / dy2);
+      delta = sycl::fabs(curr[c] - prev[c]);
+    }
+    delta = reduce_over_group(it.get_group(), delta, maximum<double>());
+
+    if (it.get_local_linear_id() == 0) {
+      change[t] = delta;
+    }
+  });
+
+  // Count the tiles updated on this time step, and activate the tiles for
+  // the next one
+  Q.submit([&](handler &cgh) {
+    auto computed = reduction(tiles->computed.data(), plus<long>());
+
+    cgh.parallel_for(
+      range<2>(nty, ntx),
+      computed,
+      [=](id<2> id, auto &computed) {
+        const int tj = id[0];
+        const int ti = id[1];
+
+        // a tile depends on the tiles sharing an edge with it
+        bool wake = change[tj * ntx + ti] >= epsilon;
+        if (tj > 0) {
+          wake = wake || change[(tj - 1) * ntx + ti] >= epsilon;
+        }
+        if (tj < nty - 1) {
+          wake = wake || change[(tj + 1) * ntx + ti] >= epsilon;
+        }
+        if (ti > 0) {
+          wake = wake || change[tj * ntx + ti - 1] >= epsilon;
+        }
+        if (ti < ntx - 1) {
+          wake = wake || change[tj * ntx + ti + 1] >= epsilon;
+        }
+
+        const int t = tj * ntx + ti;
+        if (active[t] == tile_active) {
+          computed += 1;
+        }
+        if (wake) {
+          active[t] = tile_active;
+        } else if (active[t] == tile_active) {
+          active[t] = tile_deactivated;
+        } else {
+          active[t] = tile_inactive;
+        }
+      });
+  });
+}
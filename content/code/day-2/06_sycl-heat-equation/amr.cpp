@@ -0,0 +1,519 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Block-structured adaptive mesh refinement for heat equation solver.
+// The refinement levels consist of fixed-size patches, which are updated
+// with one kernel launch per level and time step. A level halves the grid
+// spacing of the level below it, so for stability it takes four time steps
+// for each time step of that level.
+
+#include <cassert>
+#include <utility>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+
+#include "heat.h"
+
+using namespace sycl;
+
+// Number of time steps of a level for each time step of the level below
+constexpr int SUBSTEPS = 4;
+
+// View of the cells of one level for the kernels, either of the field
+// itself or of the patches of a refinement level. The cells are indexed
+// over the whole domain at the resolution of the level.
+struct level_view
+{
+  double *data;
+  // patch index of each possible patch, or nullptr for the field
+  const int *map;
+  // size of the domain in cells
+  int nx;
+  int ny;
+  // row layout of the field
+  int pitch;
+  int offset;
+  // number of possible patches along the second dimension, and the size
+  // of the patches
+  int mny;
+  int p;
+};
+
+static level_view
+field_view(field *temperature)
+{
+  return { temperature->data.data(),
+           nullptr,
+           temperature->nx,
+           temperature->ny,
+           temperature->pitch,
+           temperature->offset,
+           0,
+           0 };
+}
+
+static level_view
+patch_view(amr_level *level, double *data, int p)
+{
+  return {
+    data, level->map.data(), level->nx, level->ny, 0, 0, level->mny, p
+  };
+}
+
+// Position of the cell (ii, jj) of a patch in the patch data, where the
+// ghost layer is at ii, jj = -1 and p
+static inline int
+patch_index(int pid, int ii, int jj, int p)
+{
+  return (pid * (p + 2) + ii + 1) * (p + 2) + jj + 1;
+}
+
+// Whether the cell (i, j) of the domain is covered by a level
+static inline bool
+covered(const level_view &v, int i, int j)
+{
+  return v.map == nullptr || v.map[(i / v.p) * v.mny + j / v.p] >= 0;
+}
+
+// The cell (i, j) of a level, which has to be covered by it. The ghost
+// layers of the field are at i, j = -1 and nx, ny.
+static inline double &
+cell(const level_view &v, int i, int j)
+{
+  if (v.map == nullptr) {
+    return v.data[(i + 1) * v.pitch + v.offset + j + 1];
+  }
+  const int pid = v.map[(i / v.p) * v.mny + j / v.p];
+  return v.data[patch_index(pid, i % v.p, j % v.p, v.p)];
+}
+
+// Value of the cell (i, j) of the level l, or, outside the domain, the
+// value of the nearest ghost cell of the field
+static inline double
+value_or_boundary(
+  const level_view &v,
+  const level_view &field,
+  int l,
+  int i,
+  int j)
+{
+  if (i >= 0 && i < v.nx && j >= 0 && j < v.ny) {
+    return cell(v, i, j);
+  }
+  const int fi = i < 0 ? -1 : sycl::min(i >> l, field.nx);
+  const int fj = j < 0 ? -1 : sycl::min(j >> l, field.ny);
+  return cell(field, fi, fj);
+}
+
+// Bilinear interpolation of the coarse level l at the centre of the cell
+// (i, j) of the level l + 1, at the fraction alpha of the time step of the
+// coarse level from old to next
+static inline double
+interpolate(
+  const level_view &old,
+  const level_view &next,
+  const level_view &field,
+  int l,
+  double alpha,
+  int i,
+  int j)
+{
+  // the coarse cells below and above the centre of the fine cell, and the
+  // weights of the ones above
+  const int ci    = (i - 1) >> 1;
+  const int cj    = (j - 1) >> 1;
+  const double wi = (i & 1) ? 0.25 : 0.75;
+  const double wj = (j & 1) ? 0.25 : 0.75;
+
+  double value = 0.0;
+  for (int di = 0; di < 2; di++) {
+    for (int dj = 0; dj < 2; dj++) {
+      const double w  = (di ? wi : 1.0 - wi) * (dj ? wj : 1.0 - wj);
+      const double v0 = value_or_boundary(old, field, l, ci + di, cj + dj);
+      const double v1 = value_or_boundary(next, field, l, ci + di, cj + dj);
+
+      value += w * ((1.0 - alpha) * v0 + alpha * v1);
+    }
+  }
+  return value;
+}
+
+// Fill the ghost layers of the patches of the level l, and their cells
+// outside the domain, at the fraction alpha of the time step of the coarse
+// level. A ghost cell is copied from a neighbouring patch of the same level
+// if there is one, and interpolated from the coarse level otherwise.
+static void
+fill_ghosts(
+  queue &Q,
+  amr_level *level,
+  int l,
+  int p,
+  const level_view &old,
+  const level_view &next,
+  const level_view &field,
+  double alpha)
+{
+  const auto self   = patch_view(level, level->prev.data(), p);
+  const int *origin = level->origin.data();
+  const int nx      = level->nx;
+  const int ny      = level->ny;
+  double *data      = level->prev.data();
+
+  Q.parallel_for(range<3>(level->npatches, p + 2, p + 2), [=](id<3> id) {
+    const int pid = id[0];
+    const int ii  = static_cast<int>(id[1]) - 1;
+    const int jj  = static_cast<int>(id[2]) - 1;
+    const int i   = origin[2 * pid] * p + ii;
+    const int j   = origin[2 * pid + 1] * p + jj;
+
+    const bool inside = i >= 0 && i < nx && j >= 0 && j < ny;
+    const bool ghost  = ii < 0 || ii >= p || jj < 0 || jj >= p;
+    if (inside && !ghost) {
+      return;
+    }
+
+    double value;
+    if (!inside) {
+      value = value_or_boundary(self, field, l, i, j);
+    } else if (covered(self, i, j)) {
+      value = cell(self, i, j);
+    } else {
+      value = interpolate(old, next, field, l - 1, alpha, i, j);
+    }
+    data[patch_index(pid, ii, jj, p)] = value;
+  });
+}
+
+// Update the temperature values of all the patches of a level using
+// five-point stencil, with a single kernel launch
+static void
+evolve_patches(
+  queue &Q,
+  amr_level *level,
+  int p,
+  double a,
+  double dt,
+  double dx2,
+  double dy2)
+{
+  const int *origin  = level->origin.data();
+  const int nx       = level->nx;
+  const int ny       = level->ny;
+  double *curr       = level->curr.data();
+  const double *prev = level->prev.data();
+
+  // distance between neighbouring values across the rows
+  const int ld = p + 2;
+
+  Q.parallel_for(range<3>(level->npatches, p, p), [=](id<3> id) {
+    const int pid = id[0];
+    const int ii  = id[1];
+    const int jj  = id[2];
+    // cells outside the domain are not updated
+    if (
+      origin[2 * pid] * p + ii >= nx || origin[2 * pid + 1] * p + jj >= ny) {
+      return;
+    }
+
+    const int c = patch_index(pid, ii, jj, p);
+    curr[c] =
+      prev[c] +
+      a * dt *
+        ((prev[c + 1] - 2.0 * prev[c] + prev[c - 1]) / dx2 +
+         (prev[c + ld] - 2.0 * prev[c] + prev[c - ld]) / dy2);
+  });
+}
+
+// Replace the values of the coarse level covered by the patches of a level
+// with the averages of the fine cells
+static void
+restrict_patches(queue &Q, amr_level *level, int p, const level_view &coarse)
+{
+  const int *origin  = level->origin.data();
+  const double *fine = level->prev.data();
+  const int h        = p / 2;
+
+  Q.parallel_for(range<3>(level->npatches, h, h), [=](id<3> id) {
+    const int pid = id[0];
+    const int ci  = origin[2 * pid] * h + id[1];
+    const int cj  = origin[2 * pid + 1] * h + id[2];
+    if (ci >= coarse.nx || cj >= coarse.ny) {
+      return;
+    }
+
+    const int ii = 2 * id[1];
+    const int jj = 2 * id[2];
+    cell(coarse, ci, cj) = 0.25 * (fine[patch_index(pid, ii, jj, p)] +
+                                   fine[patch_index(pid, ii, jj + 1, p)] +
+                                   fine[patch_index(pid, ii + 1, jj, p)] +
+                                   fine[patch_index(pid, ii + 1, jj + 1, p)]);
+  });
+}
+
+// Advance the refinement level l by one time step of the level l - 1, whose
+// values go from old to next over the step. The finer levels are advanced
+// recursively after each substep, and the level is restricted onto next at
+// the end.
+static void
+advance_level(
+  queue &Q,
+  amr_hierarchy *amr,
+  int l,
+  const level_view &old,
+  const level_view &next,
+  const level_view &field,
+  double a,
+  double dt,
+  double dx2,
+  double dy2)
+{
+  if (l > static_cast<int>(amr->levels.size())) {
+    return;
+  }
+  amr_level *level = &amr->levels[l - 1];
+  if (level->npatches == 0) {
+    return;
+  }
+
+  const int p = amr->patch_size;
+
+  // halving the grid spacing quarters the stable time step
+  dt /= SUBSTEPS;
+  dx2 /= 4.0;
+  dy2 /= 4.0;
+
+  for (int k = 0; k < SUBSTEPS; k++) {
+    fill_ghosts(Q, level, l, p, old, next, field, double(k) / SUBSTEPS);
+    evolve_patches(Q, level, p, a, dt, dx2, dy2);
+    advance_level(
+      Q,
+      amr,
+      l + 1,
+      patch_view(level, level->prev.data(), p),
+      patch_view(level, level->curr.data(), p),
+      field,
+      a,
+      dt,
+      dx2,
+      dy2);
+    std::swap(level->curr, level->prev);
+  }
+
+  restrict_patches(Q, level, p, next);
+}
+
+// Update the temperature values of a field and of its refinement levels by
+// one time step of the field. The values of the field under the patches are
+// replaced with the averages of the patches.
+void
+evolve_amr(
+  queue &Q,
+  amr_hierarchy *amr,
+  field *curr,
+  field *prev,
+  double a,
+  double dt,
+  double dx2,
+  double dy2)
+{
+  evolve(Q, curr->data.data(), prev->data.data(), curr, a, dt, dx2, dy2);
+  advance_level(
+    Q,
+    amr,
+    1,
+    field_view(prev),
+    field_view(curr),
+    field_view(prev),
+    a,
+    dt,
+    dx2,
+    dy2);
+}
+
+// Flag the possible patches of the level l + 1 where the temperature of
+// the level l differs from a neighbouring cell by at least threshold per
+// unit length. The flagged area includes a ring of one coarse cell around
+// each patch.
+static void
+flag_patches(
+  queue &Q,
+  const level_view &coarse,
+  const level_view &field,
+  int l,
+  int mnx,
+  int mny,
+  int p,
+  double threshold,
+  uint8_t *flags)
+{
+  const int h = p / 2;
+
+  Q.parallel_for(range<2>(mnx, mny), [=](id<2> id) {
+    const int pi = id[0];
+    const int pj = id[1];
+
+    bool flag = false;
+    for (int ci = pi * h - 1; ci <= (pi + 1) * h; ci++) {
+      for (int cj = pj * h - 1; cj <= (pj + 1) * h; cj++) {
+        if (
+          ci < 0 || ci >= coarse.nx || cj < 0 || cj >= coarse.ny ||
+          !covered(coarse, ci, cj)) {
+          continue;
+        }
+        const double value = cell(coarse, ci, cj);
+        const int ni[4]    = { ci - 1, ci + 1, ci, ci };
+        const int nj[4]    = { cj, cj, cj - 1, cj + 1 };
+        for (int n = 0; n < 4; n++) {
+          const bool inside =
+            ni[n] >= 0 && ni[n] < coarse.nx && nj[n] >= 0 && nj[n] < coarse.ny;
+          if (inside && !covered(coarse, ni[n], nj[n])) {
+            continue;
+          }
+          const double neighbour =
+            value_or_boundary(coarse, field, l, ni[n], nj[n]);
+          flag = flag || sycl::fabs(neighbour - value) >= threshold;
+        }
+      }
+    }
+    flags[pi * mny + pj] = flag;
+  });
+  Q.wait();
+}
+
+// Initialise the patches of a new level l from the patches of the old one
+// where they coincide, and by interpolation from the coarse level elsewhere
+static void
+initialize_patches(
+  queue &Q,
+  amr_level *level,
+  amr_level *old,
+  int l,
+  int p,
+  const level_view &coarse,
+  const level_view &field)
+{
+  const int *origin   = level->origin.data();
+  const int nx        = level->nx;
+  const int ny        = level->ny;
+  const auto previous = patch_view(old, old->prev.data(), p);
+  const bool has_old  = old->npatches > 0;
+  double *data        = level->prev.data();
+
+  Q.parallel_for(range<3>(level->npatches, p, p), [=](id<3> id) {
+    const int pid = id[0];
+    const int ii  = id[1];
+    const int jj  = id[2];
+    const int i   = origin[2 * pid] * p + ii;
+    const int j   = origin[2 * pid + 1] * p + jj;
+    if (i >= nx || j >= ny) {
+      return;
+    }
+
+    double value;
+    if (has_old && covered(previous, i, j)) {
+      value = cell(previous, i, j);
+    } else {
+      value = interpolate(coarse, coarse, field, l - 1, 0.0, i, j);
+    }
+    data[patch_index(pid, ii, jj, p)] = value;
+  });
+  Q.wait();
+}
+
+// Rebuild the refinement levels on top of a field from the current
+// temperature values, from the coarsest level up. The patches of a level
+// are placed where the level below has steep gradients, and only where
+// the level below covers them together with a ring of one coarse cell, so
+// that their ghost layers can be interpolated from it.
+void
+regrid(queue &Q, amr_hierarchy *amr, field *temperature)
+{
+  const int p = amr->patch_size;
+  const int h = p / 2;
+  assert(p % 2 == 0);
+
+  const auto field = field_view(temperature);
+  auto coarse      = field;
+
+  // grid spacing of the coarse level
+  double dx = temperature->dx;
+
+  for (int l = 1; l <= static_cast<int>(amr->levels.size()); l++) {
+    amr_level *old = &amr->levels[l - 1];
+
+    amr_level level { Q };
+    level.nx  = coarse.nx * 2;
+    level.ny  = coarse.ny * 2;
+    level.mnx = (level.nx + p - 1) / p;
+    level.mny = (level.ny + p - 1) / p;
+
+    std::vector<uint8_t, field_allocator<uint8_t>> flags(
+      level.mnx * level.mny, field_allocator<uint8_t>(Q));
+    flag_patches(
+      Q,
+      coarse,
+      field,
+      l - 1,
+      level.mnx,
+      level.mny,
+      p,
+      amr->threshold * dx,
+      flags.data());
+
+    // Keep the flagged patches that are properly nested in the coarse level
+    level.map.assign(level.mnx * level.mny, -1);
+    level.npatches = 0;
+    for (int pi = 0; pi < level.mnx; pi++) {
+      for (int pj = 0; pj < level.mny; pj++) {
+        if (!flags[pi * level.mny + pj]) {
+          continue;
+        }
+        bool nested = true;
+        for (int ci = pi * h - 1; ci <= (pi + 1) * h; ci++) {
+          for (int cj = pj * h - 1; cj <= (pj + 1) * h; cj++) {
+            if (
+              ci >= 0 && ci < coarse.nx && cj >= 0 && cj < coarse.ny &&
+              !covered(coarse, ci, cj)) {
+              nested = false;
+            }
+          }
+        }
+        if (nested) {
+          level.map[pi * level.mny + pj] = level.npatches++;
+          level.origin.push_back(pi);
+          level.origin.push_back(pj);
+        }
+      }
+    }
+
+    const size_t size = level.npatches * (p + 2) * (p + 2);
+    level.curr.resize(size);
+    level.prev.resize(size);
+    if (level.npatches > 0) {
+      initialize_patches(Q, &level, old, l, p, coarse, field);
+    }
+
+    *old   = std::move(level);
+    coarse = patch_view(old, old->prev.data(), p);
+    dx /= 2.0;
+  }
+}
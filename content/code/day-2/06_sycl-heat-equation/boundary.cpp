@@ -0,0 +1,122 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Boundary conditions for heat equation solver, applied on the device by
+// refreshing the ghost layers
+
+#include <sycl/sycl.hpp>
+
+#include "heat.h"
+
+using namespace sycl;
+
+// Value of a ghost cell under a Neumann or periodic boundary condition.
+// Dirichlet ghost cells keep their values and are not written.
+// Arguments:
+//   condition: boundary condition of the side of the ghost cell
+//   inner: value of the adjacent interior cell
+//   opposite: value of the interior cell at the opposite side of the grid
+//   h: grid spacing across the boundary
+static inline double
+ghost_value(
+  const boundary_condition &condition,
+  double inner,
+  double opposite,
+  double h)
+{
+  if (condition.kind == boundary_kind::neumann) {
+    return inner + h * condition.value;
+  }
+  return opposite;
+}
+
+// Refresh the ghost layers of a field held in USM allocations the device
+// can access, according to the boundary conditions of its four sides.
+// A single kernel updates all the ghost cells, so that the field never has
+// to come back to the host between the time steps. The corners of the ghost
+// layers are not used by the five-point stencil and are left as they are,
+// and so are the ghost layers of the Dirichlet sides, which hold the fixed
+// temperatures of the field as it was generated or read.
+// On an out-of-order queue the kernel waits for the events in dependencies.
+// When all the sides are Dirichlet ones no kernel is launched, and the
+// returned event is a complete one that does not wait for dependencies.
+event
+apply_boundaries(
+  queue &Q,
+  double *data,
+  const field *layout,
+  const boundary_conditions *conditions,
+  const std::vector<event> &dependencies)
+{
+  // leading dimension of the field
+  const int ld = layout->pitch;
+
+  const int nx     = layout->nx;
+  const int ny     = layout->ny;
+  const int offset = layout->offset;
+
+  // differences across the rows are scaled by dy, and along them by dx
+  const double dx = layout->dx;
+  const double dy = layout->dy;
+
+  const auto side = conditions->side;
+
+  bool all_dirichlet = true;
+  for (const auto &condition : side) {
+    all_dirichlet &= condition.kind == boundary_kind::dirichlet;
+  }
+  if (all_dirichlet) {
+    return event();
+  }
+
+  constexpr auto dirichlet = boundary_kind::dirichlet;
+
+  return Q.submit([&](handler &cgh) {
+    cgh.depends_on(dependencies);
+    cgh.parallel_for(range<1>(nx + ny), [=](id<1> id) {
+      const int k = id[0];
+      if (k < ny) {
+        // ghost rows i = 0 and i = nx+1
+        const int j     = offset + k + 1;
+        const int first = ld + j;
+        const int last  = nx * ld + j;
+        if (side[0].kind != dirichlet) {
+          data[j] = ghost_value(side[0], data[first], data[last], dy);
+        }
+        if (side[1].kind != dirichlet) {
+          data[last + ld] = ghost_value(side[1], data[last], data[first], dy);
+        }
+      } else {
+        // ghost columns j = 0 and j = ny+1
+        const int row      = (k - ny + 1) * ld + offset;
+        const int first    = row + 1;
+        const int last     = row + ny;
+        if (side[2].kind != dirichlet) {
+          data[row] = ghost_value(side[2], data[first], data[last], dx);
+        }
+        if (side[3].kind != dirichlet) {
+          data[row + ny + 1] =
+            ghost_value(side[3], data[last], data[first], dx);
+        }
+      }
+    });
+  });
+}
@@ -37,8 +37,10 @@ void
 evolve(queue &Q, field *curr, field *prev, double a, double dt)
 {
   // Help the compiler avoid being confused by the structs
-  auto nx = curr->nx;
-  auto ny = curr->ny;
+  auto nx     = curr->nx;
+  auto ny     = curr->ny;
+  auto pitch  = curr->pitch;
+  auto offset = curr->offset;
 
   // Determine the temperature field at next time step
   // As we have fixed boundary conditions, the outermost gridpoints
@@ -47,8 +49,8 @@ evolve(queue &Q, field *curr, field *prev, double a, double dt)
   auto dy2 = prev->dy * prev->dy;
 
   {
-    buffer<double, 2> buf_curr { curr->data.data(), range<2>(nx + 2, ny + 2) },
-      buf_prev { prev->data.data(), range<2>(nx + 2, ny + 2) };
+    buffer<double, 2> buf_curr { curr->data.data(), range<2>(nx + 2, pitch) },
+      buf_prev { prev->data.data(), range<2>(nx + 2, pitch) };
 
     Q.submit([&](handler &cgh) {
       auto acc_curr = accessor(buf_curr, cgh, read_write);
@@ -56,7 +58,7 @@ evolve(queue &Q, field *curr, field *prev, double a, double dt)
 
       cgh.parallel_for(range<2>(nx, ny), [=](id<2> id) {
         auto j = id[0] + 1;
-        auto i = id[1] + 1;
+        auto i = id[1] + 1 + offset;
 
         acc_curr[j][i] =
           acc_prev[j][i] +
@@ -69,3 +71,139 @@ evolve(queue &Q, field *curr, field *prev, double a, double dt)
     });
   }
 }
+
+// Update the temperature values using five-point stencil, staging the
+// previous values in local memory.
+// Each work-group loads its tile of prev, together with a one-cell halo,
+// into local memory once and then computes the stencil from there, rather
+// than having every work-item read its five neighbours from global memory.
+// Arguments:
+//   curr: current temperature values
+//   prev: temperature values from previous time step
+//   a: diffusivity
+//   dt: time step
+//   tile: work-group size, i.e. the shape of the tile owned by a work-group
+void
+evolve_tiled(
+  queue &Q,
+  field *curr,
+  field *prev,
+  double a,
+  double dt,
+  range<2> tile)
+{
+  // Help the compiler avoid being confused by the structs
+  auto nx     = curr->nx;
+  auto ny     = curr->ny;
+  auto pitch  = curr->pitch;
+  auto offset = curr->offset;
+
+  const int ty = tile[0];
+  const int tx = tile[1];
+
+  auto dx2 = prev->dx * prev->dx;
+  auto dy2 = prev->dy * prev->dy;
+
+  // the global range spans the interior, rounded up to a multiple of the
+  // tile size
+  range global { static_cast<size_t>((nx + ty - 1) / ty * ty),
+                 static_cast<size_t>((ny + tx - 1) / tx * tx) };
+
+  {
+    buffer<double, 2> buf_curr { curr->data.data(), range<2>(nx + 2, pitch) },
+      buf_prev { prev->data.data(), range<2>(nx + 2, pitch) };
+
+    Q.submit([&](handler &cgh) {
+      auto acc_curr = accessor(buf_curr, cgh, read_write);
+      auto acc_prev = accessor(buf_prev, cgh, read_only);
+
+      // tile of prev, including the halo, in local memory
+      auto tile_prev = local_accessor<double, 2>(range<2>(ty + 2, tx + 2), cgh);
+
+      cgh.parallel_for(nd_range { global, tile }, [=](nd_item<2> it) {
+        // global indices of the upper left corner of the tile with its halo
+        const int j0 = it.get_group(0) * ty;
+        const int i0 = it.get_group(1) * tx;
+
+        const int lj = it.get_local_id(0);
+        const int li = it.get_local_id(1);
+
+        // load the tile with its halo: the work-group is smaller than the
+        // haloed tile, so some work-items load more than one value
+        for (int jj = lj; jj < ty + 2; jj += ty) {
+          for (int ii = li; ii < tx + 2; ii += tx) {
+            if (j0 + jj <= nx + 1 && i0 + ii <= ny + 1) {
+              tile_prev[jj][ii] = acc_prev[j0 + jj][offset + i0 + ii];
+            }
+          }
+        }
+        // synchronize to ensure all work-items have a consistent view of
+        // the local memory holding the tile
+        it.barrier(access::fence_space::local_space);
+
+        const int j = j0 + lj + 1;
+        const int i = i0 + li + 1;
+        if (j <= nx && i <= ny) {
+          const int tj = lj + 1;
+          const int ti = li + 1;
+
+          acc_curr[j][offset + i] =
+            tile_prev[tj][ti] +
+            a * dt *
+              ((tile_prev[tj][ti + 1] - 2.0 * tile_prev[tj][ti] +
+                tile_prev[tj][ti - 1]) /
+                 dx2 +
+               (tile_prev[tj + 1][ti] - 2.0 * tile_prev[tj][ti] +
+                tile_prev[tj - 1][ti]) /
+                 dy2);
+        }
+      });
+    });
+  }
+}
+
+// Update the temperature values using five-point stencil, with the fields
+// held in USM allocations the device can access
+// Arguments:
+//   curr: current temperature values, in USM
+//   prev: temperature values from previous time step, in USM
+//   layout: field with the dimensions and row layout of the device arrays
+//   a: diffusivity
+//   dt: time step
+void
+evolve(
+  queue &Q,
+  double *curr,
+  const double *prev,
+  const field *layout,
+  double a,
+  double dt,
+  double dx2,
+  double dy2)
+{
+  // leading dimension of the fields, including the ghost layers and the
+  // padding at the ends of the rows
+  const int ld = layout->pitch;
+
+  const int nx     = layout->nx;
+  const int ny     = layout->ny;
+  const int offset = layout->offset;
+
+  // Determine the temperature field at next time step
+  // As we have fixed boundary conditions, the outermost gridpoints
+  // are not updated.
+  Q.parallel_for(range<2>(nx, ny), [=](id<2> id) {
+    auto j = id[0] + 1;
+    auto i = id[1] + 1 + offset;
+
+    curr[j * ld + i] =
+      prev[j * ld + i] +
+      a * dt *
+        ((prev[j * ld + i + 1] - 2.0 * prev[j * ld + i] +
+          prev[j * ld + i - 1]) /
+           dx2 +
+         (prev[(j + 1) * ld + i] - 2.0 * prev[j * ld + i] +
+          prev[(j - 1) * ld + i]) /
+           dy2);
+  });
+}
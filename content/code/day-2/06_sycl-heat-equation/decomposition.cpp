@@ -0,0 +1,262 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Domain decomposition of heat equation solver over several queues and
+// devices, with the ghost rows exchanged between the time steps
+
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+
+#include "heat.h"
+
+using namespace sycl;
+
+// Create count queues for the subdomains. On a device that can be
+// partitioned by NUMA affinity domain, e.g. a multi-socket CPU, the queues
+// are spread over its sub-devices, otherwise they all use the device of Q.
+// The queues share one context, the one of Q or, with sub-devices, a new
+// one covering all of them, since USM allocations can only be used within
+// the context they were made in.
+// The queues are out-of-order, and the time steps order their work with
+// explicit event dependencies.
+std::vector<queue>
+subdomain_queues(queue &Q, int count)
+{
+  const device root = Q.get_device();
+
+  std::vector<device> devices { root };
+  context ctx = Q.get_context();
+  try {
+    const auto domains =
+      root.get_info<info::device::partition_affinity_domains>();
+    const bool numa =
+      std::find(
+        domains.begin(),
+        domains.end(),
+        info::partition_affinity_domain::numa) != domains.end();
+    if (
+      numa && root.get_info<info::device::partition_max_sub_devices>() > 1) {
+      devices = root.create_sub_devices<
+        info::partition_property::partition_by_affinity_domain>(
+        info::partition_affinity_domain::numa);
+      ctx = context(devices);
+    }
+  } catch (const exception &) {
+    // the device cannot be partitioned after all, so keep using it whole
+  }
+
+  std::vector<queue> queues;
+  for (int k = 0; k < count; k++) {
+    queues.emplace_back(ctx, devices[k % devices.size()]);
+  }
+  return queues;
+}
+
+// Host memory in the context of the queues, large enough for the rows of
+// the largest strip of a field split over n strips, ghost rows included.
+// The field data is shared memory of the context of the main queue, which
+// the queues cannot use when they run on sub-devices, so the host stages
+// the rows through it.
+static double *
+allocate_staging(const context &ctx, const field *temperature, int n)
+{
+  const int nx = temperature->nx / n + (temperature->nx % n > 0 ? 1 : 0);
+  return malloc_host<double>((nx + 2) * temperature->pitch, ctx);
+}
+
+// Split the interior rows of a field into strips of nearly equal size, one
+// for each queue, and copy the strips with their ghost rows to the devices
+std::vector<subdomain>
+decompose(std::vector<queue> &queues, field *temperature)
+{
+  const int n  = queues.size();
+  const int ld = temperature->pitch;
+
+  const context ctx = queues.front().get_context();
+  double *staging   = allocate_staging(ctx, temperature, n);
+
+  std::vector<subdomain> subdomains;
+  int i0 = 0;
+  for (int k = 0; k < n; k++) {
+    auto &Q      = queues[k];
+    const int nx = temperature->nx / n + (k < temperature->nx % n ? 1 : 0);
+
+    const size_t size = (nx + 2) * ld;
+    subdomain strip { Q,
+                      i0,
+                      nx,
+                      malloc_device<double>(size, Q),
+                      malloc_device<double>(size, Q),
+                      malloc_host<double>(ld, Q),
+                      malloc_host<double>(ld, Q),
+                      event {},
+                      {} };
+
+    const double *rows = temperature->data.data() + i0 * ld;
+    std::copy(rows, rows + size, staging);
+    Q.copy(staging, strip.curr, size).wait();
+    Q.copy(staging, strip.prev, size).wait();
+
+    subdomains.push_back(std::move(strip));
+    i0 += nx;
+  }
+
+  free(staging, ctx);
+  return subdomains;
+}
+
+// Update the temperature values of all the strips using five-point stencil,
+// and exchange their ghost rows. Each strip goes through its own queue,
+// with the order given by events:
+//   1. the update waits for the previous update of the strip, and for the
+//      copies into the ghost rows of the strip and of its neighbours, which
+//      read the rows the update overwrites
+//   2. the first and last interior rows are copied to host memory once the
+//      update is done
+//   3. the rows are copied from there into the ghost rows of the
+//      neighbouring strips
+// Arguments:
+//   subdomains: the strips of the field
+//   layout: field with the dimensions and row layout of the strips
+//   a: diffusivity
+//   dt: time step
+void
+evolve(
+  std::vector<subdomain> &subdomains,
+  const field *layout,
+  double a,
+  double dt,
+  double dx2,
+  double dy2)
+{
+  const int n = subdomains.size();
+
+  // leading dimension of the strips
+  const int ld = layout->pitch;
+
+  const int ny     = layout->ny;
+  const int offset = layout->offset;
+
+  for (int k = 0; k < n; k++) {
+    auto &strip = subdomains[k];
+
+    std::vector<event> dependencies { strip.step };
+    for (int m = std::max(0, k - 1); m <= std::min(n - 1, k + 1); m++) {
+      dependencies.insert(
+        dependencies.end(),
+        subdomains[m].halo.begin(),
+        subdomains[m].halo.end());
+    }
+
+    double *curr       = strip.curr;
+    const double *prev = strip.prev;
+
+    strip.step = strip.Q.submit([&](handler &cgh) {
+      cgh.depends_on(dependencies);
+      cgh.parallel_for(range<2>(strip.nx, ny), [=](id<2> id) {
+        const int c = (id[0] + 1) * ld + offset + id[1] + 1;
+
+        curr[c] =
+          prev[c] +
+          a * dt *
+            ((prev[c + 1] - 2.0 * prev[c] + prev[c - 1]) / dx2 +
+             (prev[c + ld] - 2.0 * prev[c] + prev[c - ld]) / dy2);
+      });
+    });
+  }
+
+  std::vector<event> sent_first(n), sent_last(n);
+  for (int k = 0; k < n; k++) {
+    auto &strip = subdomains[k];
+    if (k > 0) {
+      sent_first[k] =
+        strip.Q.copy(strip.curr + ld, strip.send_first, ld, strip.step);
+    }
+    if (k < n - 1) {
+      sent_last[k] = strip.Q.copy(
+        strip.curr + strip.nx * ld,
+        strip.send_last,
+        ld,
+        strip.step);
+    }
+  }
+
+  for (int k = 0; k < n; k++) {
+    auto &strip = subdomains[k];
+    strip.halo.clear();
+    if (k > 0) {
+      strip.halo.push_back(strip.Q.copy(
+        subdomains[k - 1].send_last,
+        strip.curr,
+        ld,
+        { strip.step, sent_last[k - 1] }));
+    }
+    if (k < n - 1) {
+      strip.halo.push_back(strip.Q.copy(
+        subdomains[k + 1].send_first,
+        strip.curr + (strip.nx + 1) * ld,
+        ld,
+        { strip.step, sent_first[k + 1] }));
+    }
+    // Swap the strips, so that the current values will be used as
+    // previous for next iteration step
+    std::swap(strip.curr, strip.prev);
+  }
+}
+
+// Copy the interior rows of all the strips back to a field
+void
+gather(std::vector<subdomain> &subdomains, field *temperature)
+{
+  const int ld = temperature->pitch;
+
+  const context ctx = subdomains.front().Q.get_context();
+  double *staging   = allocate_staging(ctx, temperature, subdomains.size());
+
+  for (auto &strip : subdomains) {
+    const size_t size = strip.nx * ld;
+    strip.Q.wait();
+    strip.Q.copy(strip.prev + ld, staging, size).wait();
+    std::copy(
+      staging,
+      staging + size,
+      temperature->data.data() + (strip.i0 + 1) * ld);
+  }
+
+  free(staging, ctx);
+}
+
+// Free the memory of the strips
+void
+free_subdomains(std::vector<subdomain> &subdomains)
+{
+  for (auto &strip : subdomains) {
+    strip.Q.wait();
+    free(strip.curr, strip.Q);
+    free(strip.prev, strip.Q);
+    free(strip.send_first, strip.Q);
+    free(strip.send_last, strip.Q);
+  }
+  subdomains.clear();
+}
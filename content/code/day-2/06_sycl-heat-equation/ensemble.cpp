@@ -0,0 +1,201 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Ensemble of heat equation solvers, which advances many small independent
+// fields with a single kernel launch per time step
+
+#include <vector>
+
+#include <sycl/sycl.hpp>
+
+#include "heat.h"
+
+using namespace sycl;
+
+// Work-group size of the reduction of the averages
+constexpr size_t AVERAGE_GROUP_SIZE = 128;
+
+// Strides of the data of an ensemble: the value at the grid point (i, j) of
+// member e is at e * member_stride + (i * (ny + 2) + j) * point_stride
+struct ensemble_strides
+{
+  size_t member_stride;
+  size_t point_stride;
+};
+
+static ensemble_strides
+strides(const ensemble *fields)
+{
+  const size_t points = (fields->nx + 2) * (fields->ny + 2);
+  if (fields->layout == ensemble_layout::batch_major) {
+    return { points, 1 };
+  }
+  return { 1, static_cast<size_t>(fields->size) };
+}
+
+// Launch kernel(e, i, j) over the members e and the grid points (i, j) of
+// an ensemble. The members are the slowest index of the launch with the
+// batch-major layout and the fastest with the grid-major one, so that
+// neighbouring work-items always access neighbouring values.
+template <typename Kernel>
+static void
+parallel_for_members(
+  queue &Q,
+  const ensemble *fields,
+  int nx,
+  int ny,
+  Kernel kernel)
+{
+  const size_t size = fields->size;
+  if (fields->layout == ensemble_layout::batch_major) {
+    Q.parallel_for(range<3>(size, nx, ny), [=](id<3> id) {
+      kernel(id[0], id[1], id[2]);
+    });
+  } else {
+    Q.parallel_for(range<3>(nx, ny, size), [=](id<3> id) {
+      kernel(id[2], id[0], id[1]);
+    });
+  }
+}
+
+// Allocate the data of an ensemble and generate the initial fields on the
+// device: a disc in the center of the grid, with each member having its
+// own radius and boundary temperatures
+void
+generate_ensemble(queue &Q, ensemble *fields)
+{
+  // Help the compiler avoid being confused by the structs
+  const int nx      = fields->nx;
+  const int ny      = fields->ny;
+  const auto layout = strides(fields);
+
+  fields->data.resize(fields->size * (nx + 2) * (ny + 2));
+  double *data                  = fields->data.data();
+  const ensemble_member *member = fields->members.data();
+
+  parallel_for_members(Q, fields, nx + 2, ny + 2, [=](int e, int i, int j) {
+    const size_t ind =
+      e * layout.member_stride + (i * (ny + 2) + j) * layout.point_stride;
+
+    double value;
+    if (i == 0) {
+      value = member[e].boundary[0];
+    } else if (i == nx + 1) {
+      value = member[e].boundary[1];
+    } else if (j == 0) {
+      value = member[e].boundary[2];
+    } else if (j == ny + 1) {
+      value = member[e].boundary[3];
+    } else {
+      // Distance of point i, j from the origin
+      const int dx        = i - nx / 2 + 1;
+      const int dy        = j - ny / 2 + 1;
+      const double radius = nx / member[e].scale;
+      value = dx * dx + dy * dy < radius * radius ? 5.0 : 65.0;
+    }
+    data[ind] = value;
+  });
+  Q.wait();
+}
+
+// Update the temperature values of all the members of an ensemble using
+// five-point stencil, with a single kernel launch. Each member uses its own
+// diffusivity, and dt has to be stable for the largest of them.
+void
+evolve(queue &Q, ensemble *curr, ensemble *prev, double dt)
+{
+  // Help the compiler avoid being confused by the structs
+  const int nx      = curr->nx;
+  const int ny      = curr->ny;
+  const auto layout = strides(curr);
+
+  auto dx2 = prev->dx * prev->dx;
+  auto dy2 = prev->dy * prev->dy;
+
+  // distances between neighbouring values along the rows and across them
+  const size_t di = layout.point_stride;
+  const size_t dj = (ny + 2) * layout.point_stride;
+
+  double *d_curr                = curr->data.data();
+  const double *d_prev          = prev->data.data();
+  const ensemble_member *member = curr->members.data();
+
+  // As we have fixed boundary conditions, the outermost gridpoints
+  // are not updated.
+  parallel_for_members(Q, curr, nx, ny, [=](int e, int j, int i) {
+    const size_t c = e * layout.member_stride +
+                     ((j + 1) * (ny + 2) + i + 1) * layout.point_stride;
+
+    d_curr[c] =
+      d_prev[c] +
+      member[e].a * dt *
+        ((d_prev[c + di] - 2.0 * d_prev[c] + d_prev[c - di]) / dx2 +
+         (d_prev[c + dj] - 2.0 * d_prev[c] + d_prev[c - dj]) / dy2);
+  });
+}
+
+// Calculate the average temperatures over the non-boundary grid cells of
+// all the members of an ensemble. A single kernel reduces all the members,
+// with one work-group per member.
+std::vector<double>
+averages(queue &Q, const ensemble *fields)
+{
+  // Help the compiler avoid being confused by the structs
+  const int nx      = fields->nx;
+  const int ny      = fields->ny;
+  const auto layout = strides(fields);
+
+  const double *data = fields->data.data();
+  auto d_averages    = malloc_shared<double>(fields->size, Q);
+
+  nd_range<1> groups { range<1>(fields->size * AVERAGE_GROUP_SIZE),
+                       range<1>(AVERAGE_GROUP_SIZE) };
+  Q.parallel_for(groups, [=](nd_item<1> it) {
+    const int e = it.get_group(0);
+
+    // each work-item sums a strided share of the grid points
+    double sum = 0.0;
+    for (int k = it.get_local_id(0); k < nx * ny; k += AVERAGE_GROUP_SIZE) {
+      const int i = k / ny + 1;
+      const int j = k % ny + 1;
+      sum += data[e * layout.member_stride +
+                  (i * (ny + 2) + j) * layout.point_stride];
+    }
+    sum = reduce_over_group(it.get_group(), sum, plus<double>());
+
+    if (it.get_local_id(0) == 0) {
+      d_averages[e] = sum / (nx * ny);
+    }
+  });
+  Q.wait();
+
+  std::vector<double> result(d_averages, d_averages + fields->size);
+  free(d_averages, Q);
+
+  return result;
+}
+
+// Swap the data of two ensembles
+void
+swap_fields(ensemble *fields1, ensemble *fields2)
+{
+  std::swap(fields1->data, fields2->data);
+}
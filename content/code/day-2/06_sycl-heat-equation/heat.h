@@ -21,10 +21,54 @@
 
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
 #include <vector>
 
 #include <sycl/sycl.hpp>
 
+// Largest supported row alignment, in bytes. The field data is always
+// allocated with this alignment, so that any smaller power of two row
+// alignment can be obtained by padding the rows.
+constexpr std::size_t FIELD_ALIGNMENT = 4096;
+
+// Allocator for the field data: USM shared memory can be accessed both by
+// the host and by kernels on the device, without any staging copies.
+// Elements constructed without a value are default-initialised, i.e. left
+// unwritten, so that resizing the data does not touch the memory from the
+// host before a kernel has initialised it.
+template <typename T>
+struct field_allocator
+  : sycl::usm_allocator<T, sycl::usm::alloc::shared, FIELD_ALIGNMENT>
+{
+  using base =
+    sycl::usm_allocator<T, sycl::usm::alloc::shared, FIELD_ALIGNMENT>;
+  using base::base;
+
+  template <typename U>
+  struct rebind
+  {
+    using other = field_allocator<U>;
+  };
+
+  template <typename U>
+  void
+  construct(U *p)
+  {
+    ::new (static_cast<void *>(p)) U;
+  }
+
+  template <typename U, typename... Args>
+  void
+  construct(U *p, Args &&...args)
+  {
+    ::new (static_cast<void *>(p)) U(std::forward<Args>(args)...);
+  }
+};
+
 // Datatype for temperature field
 struct field
 {
@@ -32,11 +76,266 @@ struct field
   // contains also ghost layers, so it will have dimensions nx+2 x ny+2
   int nx;
   int ny;
+  // The rows of the array data are stored pitch values apart, and each row
+  // starts with offset padding values before its first ghost value. The
+  // padding places the first interior value of every row on an aligned
+  // address. Without padding pitch is ny+2 and offset is 0.
+  int pitch;
+  int offset;
   // Size of the grid cells
   double dx;
   double dy;
   // The temperature values in the 2D grid
-  std::vector<double> data;
+  std::vector<double, field_allocator<double>> data;
+
+  // The field data is allocated in the USM shared memory of the queue Q
+  explicit field(sycl::queue &Q)
+    : data(field_allocator<double>(Q))
+  {}
+};
+
+// Position of the grid point (i, j) in the data of a field, where i is the
+// index along the first dimension and both indices count the ghost layers
+inline int
+field_index(const field *temperature, int i, int j)
+{
+  return i * temperature->pitch + temperature->offset + j;
+}
+
+// Kinds of boundary conditions
+enum class boundary_kind
+{
+  // fixed temperature, the one of the ghost layer
+  dirichlet,
+  // fixed outward normal derivative of the temperature
+  neumann,
+  // the grid wraps around to the opposite side
+  periodic
+};
+
+// Boundary condition of one side of the grid. The value is the outward
+// normal derivative of a Neumann boundary. A Dirichlet boundary keeps the
+// temperatures already in its ghost layer.
+struct boundary_condition
+{
+  boundary_kind kind;
+  double value;
+};
+
+// Boundary conditions of the four sides of the grid, in the order i = 0,
+// i = nx+1, j = 0 and j = ny+1, where i is the index along the first
+// dimension. Periodic sides have to come in opposite pairs.
+struct boundary_conditions
+{
+  std::array<boundary_condition, 4> side;
+};
+
+// Largest number of materials in a material map
+constexpr int MAX_MATERIALS = 32;
+
+// Heterogeneous materials described compactly: every grid point, ghost
+// layers included, holds the index of its material in a small table of
+// diffusivities. The indices use the row layout of the temperature field.
+struct material_map
+{
+  int count;
+  std::array<double, MAX_MATERIALS> diffusivity;
+  std::vector<uint8_t, field_allocator<uint8_t>> index;
+
+  // The indices are allocated in the USM shared memory of the queue Q
+  explicit material_map(sycl::queue &Q)
+    : index(field_allocator<uint8_t>(Q))
+  {}
+};
+
+// Activity of the tiles of the grid, for skipping the tiles that have
+// reached equilibrium. A tile is updated only while the temperature in it
+// or in one of its neighbouring tiles changes by at least epsilon per step.
+struct active_tiles
+{
+  // size of the tiles, and the number of tiles in both dimensions
+  int ty;
+  int tx;
+  int nty;
+  int ntx;
+  double epsilon;
+  // whether the tiles are updated on the next time step, have just been
+  // deactivated or are inactive
+  std::vector<uint8_t, field_allocator<uint8_t>> active;
+  // largest change of the temperature in the tiles on the last time step
+  std::vector<double, field_allocator<double>> change;
+  // number of tile updates computed so far, accumulated on the device
+  std::vector<long, field_allocator<long>> computed;
+
+  // The flags are allocated in the USM shared memory of the queue Q
+  explicit active_tiles(sycl::queue &Q)
+    : active(field_allocator<uint8_t>(Q))
+    , change(field_allocator<double>(Q))
+    , computed(field_allocator<long>(Q))
+  {}
+};
+
+// One refinement level of a block-structured adaptive mesh. Each level
+// halves the grid spacing of the one below it, and the level is divided
+// into a regular grid of possible patches of a fixed size, of which only
+// the patches where the temperature changes steeply are in use. Every
+// patch includes a ghost layer.
+struct amr_level
+{
+  // size of the whole domain in cells of this level
+  int nx;
+  int ny;
+  // number of possible patches along the two dimensions
+  int mnx;
+  int mny;
+  // number of patches in use
+  int npatches;
+  // index of each possible patch among the patches in use, or -1
+  std::vector<int, field_allocator<int>> map;
+  // position of each patch in use in the grid of possible patches
+  std::vector<int, field_allocator<int>> origin;
+  // current and previous temperature values of the patches in use
+  std::vector<double, field_allocator<double>> curr;
+  std::vector<double, field_allocator<double>> prev;
+
+  // The patches are allocated in the USM shared memory of the queue Q
+  explicit amr_level(sycl::queue &Q)
+    : map(field_allocator<int>(Q))
+    , origin(field_allocator<int>(Q))
+    , curr(field_allocator<double>(Q))
+    , prev(field_allocator<double>(Q))
+  {}
+};
+
+// Hierarchy of refinement levels on top of a temperature field
+struct amr_hierarchy
+{
+  // number of cells along both dimensions of a patch, which is even
+  int patch_size;
+  // cells are refined where the temperature differs from a neighbouring
+  // cell by at least threshold per unit length
+  double threshold;
+  // the refinement levels 1, 2, ..., the field itself being level 0
+  std::vector<amr_level> levels;
+};
+
+// Part of a field owned by one queue in a domain decomposition into strips
+// along the first dimension. The strip holds the interior rows i0+1, ...,
+// i0+nx of the field, with a ghost row on both sides, in the device memory
+// of its queue. The queues of all the strips share one context, so that
+// they can copy between each other's allocations.
+struct subdomain
+{
+  sycl::queue Q;
+  int i0;
+  int nx;
+  double *curr;
+  double *prev;
+  // host memory for the first and last interior rows, on their way to the
+  // neighbouring strips
+  double *send_first;
+  double *send_last;
+  // the last update of the strip, and the copies into its ghost rows
+  sycl::event step;
+  std::vector<sycl::event> halo;
+};
+
+// Kernels of the latest time step split into the refresh of the ghost
+// layers, the update of the interior of the field, and the update of its
+// first and last rows and columns
+struct split_step
+{
+  sycl::event ghosts;
+  sycl::event interior;
+  sycl::event edges;
+};
+
+// Temperature field kept in a memory-mapped binary file instead of memory,
+// for grids larger than the memory of the host. The file holds the
+// (nx+2) x (ny+2) values, ghost layers included, as raw doubles in
+// row-major order without row padding.
+struct mapped_field
+{
+  int nx;
+  int ny;
+  double dx;
+  double dy;
+  // descriptor of the file and the mapping of all of it
+  int fd;
+  double *data;
+};
+
+// Layouts of the fields of an ensemble: with batch-major layout each field
+// is stored contiguously, with grid-major layout the values of all the
+// members at one grid point are next to each other
+enum class ensemble_layout
+{
+  batch_major,
+  grid_major
+};
+
+// Parameters of one member of an ensemble
+struct ensemble_member
+{
+  // diffusivity
+  double a;
+  // the initial disc has a radius of nx / scale grid cells
+  double scale;
+  // temperatures at the boundaries of the first dimension, i = 0 and
+  // i = nx+1, and of the second one, j = 0 and j = ny+1
+  double boundary[4];
+};
+
+// Ensemble of independent temperature fields of the same dimensions, which
+// are advanced together. Each field includes its ghost layers, without row
+// padding.
+struct ensemble
+{
+  int size;
+  int nx;
+  int ny;
+  double dx;
+  double dy;
+  ensemble_layout layout;
+  // Parameters of the members
+  std::vector<ensemble_member, field_allocator<ensemble_member>> members;
+  // The temperature values of all the members
+  std::vector<double, field_allocator<double>> data;
+
+  // The data is allocated in the USM shared memory of the queue Q
+  explicit ensemble(sycl::queue &Q)
+    : members(field_allocator<ensemble_member>(Q))
+    , data(field_allocator<double>(Q))
+  {}
+};
+
+// Summary of the temperature values over the non-boundary grid cells
+struct field_statistics
+{
+  double sum;
+  double min;
+  double max;
+};
+
+// Patterns of the initial temperature in the interior of the grid
+enum class initial_pattern
+{
+  disc,
+  gaussian,
+  random
+};
+
+// Parametric initial condition. The pattern is centred in the grid and has
+// a radius of nx / scale grid cells, with the temperature inside in its
+// centre and outside away from it. The random pattern draws uniformly
+// distributed values between the two temperatures instead.
+struct initial_condition
+{
+  const char *name;
+  initial_pattern pattern;
+  double scale;
+  double inside;
+  double outside;
 };
 
 // We use here fixed grid spacing
@@ -45,30 +344,225 @@ constexpr auto DY = 0.01;
 
 // Function prototypes
 void
-set_field_dimensions(field *temperature, int nx, int ny);
+set_field_dimensions(field *temperature, int nx, int ny, int alignment);
 
 void
 initialize(
+  sycl::queue &Q,
   int argc,
   char *argv[],
   field *temperature1,
   field *temperature2,
   int *nsteps);
 
+const initial_condition *
+find_initial_condition(const char *name);
+
 void
-generate_field(field *temperature);
+generate_field(
+  sycl::queue &Q,
+  field *temperature,
+  const initial_condition *condition,
+  unsigned seed);
+
+int
+parameter_from_env(const char *name, int fallback);
+
+double
+parameter_from_env(const char *name, double fallback);
+
+boundary_conditions
+boundary_conditions_from_env();
+
+sycl::event
+apply_boundaries(
+  sycl::queue &Q,
+  double *data,
+  const field *layout,
+  const boundary_conditions *conditions,
+  const std::vector<sycl::event> &dependencies = {});
 
 double
 average(field *temperature);
 
+field_statistics
+statistics(sycl::queue &Q, const double *d_data, const field *layout);
+
+double
+average(sycl::queue &Q, const double *d_data, const field *layout);
+
 void
 evolve(sycl::queue &Q, field *curr, field *prev, double a, double dt);
 
+void
+evolve_tiled(
+  sycl::queue &Q,
+  field *curr,
+  field *prev,
+  double a,
+  double dt,
+  sycl::range<2> tile);
+
+void
+evolve(
+  sycl::queue &Q,
+  double *curr,
+  const double *prev,
+  const field *layout,
+  double a,
+  double dt,
+  double dx2,
+  double dy2);
+
+void
+generate_materials(
+  sycl::queue &Q,
+  const field *layout,
+  int count,
+  double a,
+  material_map *materials);
+
+void
+expand_materials(
+  sycl::queue &Q,
+  const material_map *materials,
+  const field *layout,
+  field *diffusivity);
+
+void
+evolve_split(
+  sycl::queue &Q,
+  double *curr,
+  double *prev,
+  const field *layout,
+  const boundary_conditions *conditions,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  split_step *step);
+
+bool
+map_field(const char *filename, int nx, int ny, mapped_field *temperature);
+
+void
+unmap_field(mapped_field *temperature);
+
+void
+generate_field(mapped_field *temperature);
+
+double
+average(const mapped_field *temperature);
+
+void
+evolve_out_of_core(
+  sycl::queue &Q,
+  mapped_field *temperature,
+  int nsteps,
+  int slab,
+  int block,
+  double a,
+  double dt,
+  double dx2,
+  double dy2);
+
+void
+evolve_variable(
+  sycl::queue &Q,
+  double *curr,
+  const double *prev,
+  const double *diffusivity,
+  const field *layout,
+  double dt,
+  double dx2,
+  double dy2);
+
+void
+evolve_materials(
+  sycl::queue &Q,
+  double *curr,
+  const double *prev,
+  const material_map *materials,
+  const field *layout,
+  double dt,
+  double dx2,
+  double dy2);
+
+void
+allocate_active_tiles(
+  const field *layout,
+  sycl::range<2> tile,
+  double epsilon,
+  active_tiles *tiles);
+
+void
+evolve_active(
+  sycl::queue &Q,
+  double *curr,
+  const double *prev,
+  const field *layout,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  active_tiles *tiles);
+
+void
+regrid(sycl::queue &Q, amr_hierarchy *amr, field *temperature);
+
+void
+evolve_amr(
+  sycl::queue &Q,
+  amr_hierarchy *amr,
+  field *curr,
+  field *prev,
+  double a,
+  double dt,
+  double dx2,
+  double dy2);
+
+std::vector<sycl::queue>
+subdomain_queues(sycl::queue &Q, int count);
+
+std::vector<subdomain>
+decompose(std::vector<sycl::queue> &queues, field *temperature);
+
+void
+evolve(
+  std::vector<subdomain> &subdomains,
+  const field *layout,
+  double a,
+  double dt,
+  double dx2,
+  double dy2);
+
+void
+gather(std::vector<subdomain> &subdomains, field *temperature);
+
+void
+free_subdomains(std::vector<subdomain> &subdomains);
+
+void
+generate_ensemble(sycl::queue &Q, ensemble *fields);
+
+void
+evolve(sycl::queue &Q, ensemble *curr, ensemble *prev, double dt);
+
+std::vector<double>
+averages(sycl::queue &Q, const ensemble *fields);
+
+void
+swap_fields(ensemble *fields1, ensemble *fields2);
+
 void
 write_field(field *temperature, int iter);
 
 void
-read_field(field *temperature1, field *temperature2, char *filename);
+read_field(
+  field *temperature1,
+  field *temperature2,
+  char *filename,
+  int alignment);
 
 void
 copy_field(field *temperature1, field *temperature2);
@@ -78,3 +572,12 @@ swap_fields(field *temperature1, field *temperature2);
 
 void
 allocate_field(field *temperature);
+
+double *
+allocate_device_field(sycl::queue &Q, field *temperature);
+
+void
+copy_field_from_device(
+  sycl::queue &Q,
+  const double *d_data,
+  field *temperature);
@@ -40,12 +40,12 @@ write_field(field *temperature, int iter)
   // (without boundary layers) so we need to copy an array with that.
   std::vector<double> inner_data(temperature->nx * temperature->ny);
   auto inner_data_iterator = inner_data.begin();
-  auto beginning_of_row = temperature->data.begin() + (temperature->ny + 2) + 1;
-  for (int i = 0; i < temperature->nx; i++) {
+  for (int i = 1; i < temperature->nx + 1; i++) {
+    auto beginning_of_row =
+      temperature->data.begin() + field_index(temperature, i, 1);
     auto end_of_row = beginning_of_row + temperature->ny;
     std::copy(beginning_of_row, end_of_row, inner_data_iterator);
     inner_data_iterator += temperature->ny;
-    beginning_of_row = end_of_row + 2;
   }
 
   // Write out the data to a png file
@@ -57,7 +57,11 @@ write_field(field *temperature, int iter)
 // initialize the temperature fields temperature1 and
 // temperature2 to the same initial state.
 void
-read_field(field *temperature1, field *temperature2, char *filename)
+read_field(
+  field *temperature1,
+  field *temperature2,
+  char *filename,
+  int alignment)
 {
   FILE *fp;
   int nx, ny, ind;
@@ -72,11 +76,11 @@ read_field(field *temperature1, field *temperature2, char *filename)
     exit(-1);
   }
 
-  set_field_dimensions(temperature1, nx, ny);
-  set_field_dimensions(temperature2, nx, ny);
+  set_field_dimensions(temperature1, nx, ny, alignment);
+  set_field_dimensions(temperature2, nx, ny, alignment);
 
   // Allocate arrays (including boundary layers)
-  int newSize = (temperature1->nx + 2) * (temperature1->ny + 2);
+  int newSize = (temperature1->nx + 2) * temperature1->pitch;
   temperature1->data.resize(newSize, 0.0);
   temperature2->data.resize(newSize, 0.0);
 
@@ -95,27 +99,27 @@ read_field(field *temperature1, field *temperature2, char *filename)
   ny_local = temperature1->ny;
 
   // Copy to the inner part of the full temperature field
-  auto temperature_data_iterator =
-    temperature1->data.begin() + (ny_local + 2) + 1;
   auto beginning_of_row = file_data.begin();
-  for (int i = 0; i < nx_local; i++) {
+  for (int i = 1; i < nx_local + 1; i++) {
+    auto temperature_data_iterator =
+      temperature1->data.begin() + field_index(temperature1, i, 1);
     auto end_of_row = beginning_of_row + ny_local;
     std::copy(beginning_of_row, end_of_row, temperature_data_iterator);
-    temperature_data_iterator += ny_local + 2;
     beginning_of_row = end_of_row;
   }
 
   // Set the boundary values
   for (int i = 1; i < nx_local + 1; i++) {
-    temperature1->data[i * (ny_local + 2)] =
-      temperature1->data[i * (ny_local + 2) + 1];
-    temperature1->data[i * (ny_local + 2) + ny + 1] =
-      temperature1->data[i * (ny_local + 2) + ny];
+    temperature1->data[field_index(temperature1, i, 0)] =
+      temperature1->data[field_index(temperature1, i, 1)];
+    temperature1->data[field_index(temperature1, i, ny + 1)] =
+      temperature1->data[field_index(temperature1, i, ny)];
   }
   for (int j = 0; j < ny + 2; j++) {
-    temperature1->data[j] = temperature1->data[ny_local + j];
-    temperature1->data[(nx_local + 1) * (ny_local + 2) + j] =
-      temperature1->data[nx_local * (ny_local + 2) + j];
+    temperature1->data[field_index(temperature1, 0, j)] =
+      temperature1->data[field_index(temperature1, 1, j)];
+    temperature1->data[field_index(temperature1, nx_local + 1, j)] =
+      temperature1->data[field_index(temperature1, nx_local, j)];
   }
 
   copy_field(temperature1, temperature2);
@@ -21,8 +21,11 @@
 
 // Main routine for heat equation solver in 2D.
 
+#include <algorithm>
 #include <chrono>
 #include <cstdio>
+#include <cstdlib>
+#include <utility>
 
 #include <sycl/sycl.hpp>
 
@@ -30,17 +33,201 @@
 
 using namespace sycl;
 
+using wall_clock_t = std::chrono::high_resolution_clock;
+
+// Advance an ensemble of size fields for nsteps time steps and print their
+// averages. The command line arguments are the field dimensions and the
+// number of time steps, as for initialize. The last member has the
+// parameters of the single field, and the members are swept evenly to it
+// from the first one, whose diffusivity, disc radius scale and boundary
+// temperatures are given by HEAT_ENSEMBLE_A, HEAT_ENSEMBLE_SCALE and
+// HEAT_ENSEMBLE_BOUNDARY. By default only the diffusivity is swept, from
+// a / size.
+static void
+run_ensemble(queue &Q, int argc, char **argv, int size, ensemble_layout layout)
+{
+  int rows   = 2000;
+  int cols   = 2000;
+  int nsteps = 500;
+  if (argc == 4) {
+    rows   = atoi(argv[1]);
+    cols   = atoi(argv[2]);
+    nsteps = atoi(argv[3]);
+  } else if (argc != 1) {
+    printf("Unsupported number of command line arguments\n");
+    exit(-1);
+  }
+
+  // the parameters of the single field
+  const ensemble_member last { 0.5, 6.0, { 85.0, 5.0, 20.0, 70.0 } };
+
+  ensemble_member first = last;
+  first.a     = parameter_from_env("HEAT_ENSEMBLE_A", last.a / size);
+  first.scale = parameter_from_env("HEAT_ENSEMBLE_SCALE", last.scale);
+  const char *boundary = getenv("HEAT_ENSEMBLE_BOUNDARY");
+  if (boundary != nullptr) {
+    int count = sscanf(
+      boundary,
+      "%lf,%lf,%lf,%lf",
+      &first.boundary[0],
+      &first.boundary[1],
+      &first.boundary[2],
+      &first.boundary[3]);
+    if (count != 4) {
+      printf(
+        "HEAT_ENSEMBLE_BOUNDARY needs four temperatures separated by "
+        "commas\n");
+      exit(-1);
+    }
+  }
+
+  ensemble current { Q }, previous { Q };
+  for (auto fields : { &current, &previous }) {
+    fields->size   = size;
+    fields->nx     = rows;
+    fields->ny     = cols;
+    fields->dx     = DX;
+    fields->dy     = DY;
+    fields->layout = layout;
+    for (int e = 0; e < size; e++) {
+      // position of the member in the sweep, from 0 for the first to 1 for
+      // the last
+      const double t = size > 1 ? static_cast<double>(e) / (size - 1) : 1.0;
+
+      ensemble_member member;
+      member.a     = first.a + t * (last.a - first.a);
+      member.scale = first.scale + t * (last.scale - first.scale);
+      for (int side = 0; side < 4; side++) {
+        member.boundary[side] =
+          first.boundary[side] +
+          t * (last.boundary[side] - first.boundary[side]);
+      }
+      fields->members.push_back(member);
+    }
+    generate_ensemble(Q, fields);
+  }
+
+  // Compute the largest stable time step for the largest diffusivity
+  double dx2 = DX * DX;
+  double dy2 = DY * DY;
+  double dt  = dx2 * dy2 / (2.0 * std::max(first.a, last.a) * (dx2 + dy2));
+
+  auto start = wall_clock_t::now();
+
+  // Time evolution, with one kernel launch per time step for all members
+  for (int iter = 1; iter <= nsteps; iter++) {
+    evolve(Q, &current, &previous, dt);
+    swap_fields(&current, &previous);
+  }
+
+  // Average temperatures of all the members, reduced together
+  auto average_temps = averages(Q, &previous);
+
+  auto stop = wall_clock_t::now();
+
+  std::chrono::duration<float> elapsed = stop - start;
+  printf("Iterations took %.3f seconds.\n", elapsed.count());
+  for (int e = 0; e < size; e++) {
+    printf(
+      "Average temperature of member %d (a = %f, scale = %f): %f\n",
+      e,
+      previous.members[e].a,
+      previous.members[e].scale,
+      average_temps[e]);
+  }
+}
+
+// Advance a field kept in the file filename instead of memory, and print
+// its average temperature. The command line arguments are the field
+// dimensions and the number of time steps, as for initialize. A file that
+// already holds a field of these dimensions is advanced further, otherwise
+// it starts from the initial disc of generate_field.
+static void
+run_out_of_core(queue &Q, int argc, char **argv, const char *filename)
+{
+  int rows   = 2000;
+  int cols   = 2000;
+  int nsteps = 500;
+  if (argc == 4) {
+    rows   = atoi(argv[1]);
+    cols   = atoi(argv[2]);
+    nsteps = atoi(argv[3]);
+  } else if (argc != 1) {
+    printf("Unsupported number of command line arguments\n");
+    exit(-1);
+  }
+
+  mapped_field temperature;
+  bool fresh = map_field(filename, rows, cols, &temperature);
+  if (fresh) {
+    generate_field(&temperature);
+  } else {
+    printf("Continuing from the field in %s\n", filename);
+  }
+  printf("Average temperature at start: %f\n", average(&temperature));
+
+  // Diffusion constant
+  double a = 0.5;
+
+  // Compute the largest stable time step
+  double dx2 = temperature.dx * temperature.dx;
+  double dy2 = temperature.dy * temperature.dy;
+  // Time step
+  double dt = dx2 * dy2 / (2.0 * a * (dx2 + dy2));
+
+  // Rows per slab in device memory, and time steps per pass over the file
+  int slab  = parameter_from_env("HEAT_SLAB_ROWS", 256);
+  int block = parameter_from_env("HEAT_SLAB_STEPS", 8);
+
+  auto start = wall_clock_t::now();
+  evolve_out_of_core(Q, &temperature, nsteps, slab, block, a, dt, dx2, dy2);
+  auto stop = wall_clock_t::now();
+
+  std::chrono::duration<float> elapsed = stop - start;
+  printf("Iterations took %.3f seconds.\n", elapsed.count());
+  printf("Average temperature: %f\n", average(&temperature));
+  if (argc == 1 && fresh) {
+    printf("Reference value with default arguments: 59.281239\n");
+  }
+
+  unmap_field(&temperature);
+}
+
 int
 main(int argc, char **argv)
 {
   // Image output interval
   int image_interval = 1500;
 
+  // create a queue: the time loop on the shared field data relies on it
+  // being in-order
+  queue Q { property::queue::in_order() };
+
+  // Keep the field in the binary file HEAT_OUT_OF_CORE, for grids larger
+  // than the memory of the host
+  const char *mapped_file = getenv("HEAT_OUT_OF_CORE");
+  if (mapped_file != nullptr) {
+    run_out_of_core(Q, argc, argv, mapped_file);
+    return 0;
+  }
+
+  // Advance an ensemble of HEAT_ENSEMBLE fields instead of the single one,
+  // stored with batch-major (0) or grid-major (1) layout
+  int ensemble_size = parameter_from_env("HEAT_ENSEMBLE", 0);
+  if (ensemble_size > 0) {
+    auto layout = parameter_from_env("HEAT_ENSEMBLE_LAYOUT", 0) != 0
+                    ? ensemble_layout::grid_major
+                    : ensemble_layout::batch_major;
+    run_ensemble(Q, argc, argv, ensemble_size, layout);
+    return 0;
+  }
+
   // Number of time steps
   int nsteps;
-  // Current and previous temperature fields
-  field current, previous;
-  initialize(argc, argv, &current, &previous, &nsteps);
+  // Current and previous temperature fields, with their data in memory
+  // shared between the host and the device
+  field current { Q }, previous { Q };
+  initialize(Q, argc, argv, &current, &previous, &nsteps);
 
   // Output the initial field
   write_field(&current, 0);
@@ -57,29 +244,302 @@ main(int argc, char **argv)
   // Time step
   double dt = dx2 * dy2 / (2.0 * a * (dx2 + dy2));
 
-  using wall_clock_t = std::chrono::high_resolution_clock;
+  // Use the local-memory tiled stencil, with work-groups of
+  // HEAT_TILE_Y x HEAT_TILE_X work-items
+  bool tiled = parameter_from_env("HEAT_TILED", 0) != 0;
+  range<2> tile { static_cast<size_t>(parameter_from_env("HEAT_TILE_Y", 16)),
+                  static_cast<size_t>(parameter_from_env("HEAT_TILE_X", 16)) };
 
-  // create a queue
-  queue Q;
+  // Instead of going through buffers, keep both fields in device memory for
+  // the whole time evolution (1) or run the kernels directly on the shared
+  // field data (2). The features below always run on the shared field data,
+  // and cannot be combined with the device memory.
+  int usm      = parameter_from_env("HEAT_USM", 0);
+  bool use_usm = usm == 2;
+
+  // Heterogeneous materials, in HEAT_MATERIALS layers along the first
+  // dimension, given by a compact material map or, with HEAT_DIFFUSIVITY,
+  // by a full per-cell diffusivity field. They use the shared field data.
+  int nmaterials = parameter_from_env("HEAT_MATERIALS", 0);
+  bool per_cell  = parameter_from_env("HEAT_DIFFUSIVITY", 0) != 0;
+  material_map materials { Q };
+  field diffusivity { Q };
+  if (nmaterials > 0) {
+    generate_materials(Q, &current, nmaterials, a, &materials);
+    if (per_cell) {
+      expand_materials(Q, &materials, &current, &diffusivity);
+    }
+    use_usm = true;
+  }
+
+  // Skip the tiles of HEAT_TILE_Y x HEAT_TILE_X grid points where the
+  // temperature changes by less than HEAT_ACTIVE_EPSILON per time step
+  double epsilon = parameter_from_env("HEAT_ACTIVE_EPSILON", 0.0);
+  active_tiles tiles { Q };
+  if (epsilon > 0.0) {
+    allocate_active_tiles(&current, tile, epsilon, &tiles);
+    use_usm = true;
+  }
+
+  // The active tiles only take the plain stencil with a single diffusivity
+  if (epsilon > 0.0 && nmaterials > 0) {
+    printf("HEAT_ACTIVE_EPSILON cannot be combined with HEAT_MATERIALS\n");
+    exit(-1);
+  }
+
+  // Refine the grid with up to HEAT_AMR levels of patches of HEAT_AMR_PATCH
+  // x HEAT_AMR_PATCH cells, placed where the temperature gradient is at
+  // least HEAT_AMR_THRESHOLD and rebuilt every HEAT_AMR_REGRID time steps
+  int amr_levels      = parameter_from_env("HEAT_AMR", 0);
+  int regrid_interval = parameter_from_env("HEAT_AMR_REGRID", 10);
+  amr_hierarchy amr { parameter_from_env("HEAT_AMR_PATCH", 16),
+                      parameter_from_env("HEAT_AMR_THRESHOLD", 1000.0),
+                      {} };
+  for (int l = 0; l < amr_levels; l++) {
+    amr.levels.emplace_back(Q);
+    amr.levels.back().npatches = 0;
+  }
+  if (amr_levels > 0) {
+    use_usm = true;
+  }
+
+  // Split each time step of the plain stencil into kernels for the interior
+  // and the edges of the field on an out-of-order queue, so that the ghost
+  // layers are refreshed while the interior is updated
+  bool split = parameter_from_env("HEAT_SPLIT", 0) != 0;
+  queue split_queue { Q.get_context(), Q.get_device() };
+  split_step step;
+  if (split) {
+    use_usm = true;
+  }
+  if (split && (nmaterials > 0 || epsilon > 0.0 || amr_levels > 0)) {
+    printf(
+      "HEAT_SPLIT cannot be combined with HEAT_MATERIALS, "
+      "HEAT_ACTIVE_EPSILON or HEAT_AMR\n");
+    exit(-1);
+  }
+
+  // Split the grid into HEAT_SUBDOMAINS strips, each updated through its
+  // own queue, on the NUMA sub-devices of the device if it has them
+  int nsubdomains = parameter_from_env("HEAT_SUBDOMAINS", 0);
+
+  // Boundary conditions, refreshed on the device before every time step of
+  // the time evolution on the shared field data. The kernels using buffers
+  // only support the fixed Dirichlet boundaries of the initial field.
+  boundary_conditions boundaries = boundary_conditions_from_env();
+  bool dirichlet                 = true;
+  for (const auto &side : boundaries.side) {
+    if (side.kind != boundary_kind::dirichlet) {
+      dirichlet = false;
+      use_usm   = true;
+    }
+  }
+
+  // The refined patches take a single diffusivity, and fill their ghost
+  // layers at the edges of the grid from fixed boundary values
+  if (amr_levels > 0 && (!dirichlet || nmaterials > 0 || epsilon > 0.0)) {
+    printf(
+      "HEAT_AMR cannot be combined with HEAT_BOUNDARY, HEAT_MATERIALS or "
+      "HEAT_ACTIVE_EPSILON\n");
+    exit(-1);
+  }
+
+  // The strips only take plain stencil updates with the fixed boundaries
+  if (
+    nsubdomains > 0 && (!dirichlet || nmaterials > 0 || epsilon > 0.0 ||
+                        amr_levels > 0 || split || usm != 0 || tiled)) {
+    printf(
+      "HEAT_SUBDOMAINS cannot be combined with HEAT_BOUNDARY, "
+      "HEAT_MATERIALS, HEAT_ACTIVE_EPSILON, HEAT_AMR, HEAT_SPLIT, HEAT_USM "
+      "or HEAT_TILED\n");
+    exit(-1);
+  }
+
+  // The features above all work on the shared field data, while the
+  // device-memory time loop only takes the plain stencil
+  if (usm == 1 && use_usm) {
+    printf(
+      "HEAT_USM=1 cannot be combined with HEAT_BOUNDARY, HEAT_MATERIALS, "
+      "HEAT_ACTIVE_EPSILON, HEAT_AMR or HEAT_SPLIT\n");
+    exit(-1);
+  }
+  bool use_device = usm == 1;
+
+  // The tiled stencil is only used by the time loop on buffers
+  if (tiled && (use_device || use_usm)) {
+    printf(
+      "HEAT_TILED cannot be combined with HEAT_USM, HEAT_BOUNDARY, "
+      "HEAT_MATERIALS, HEAT_ACTIVE_EPSILON, HEAT_AMR or HEAT_SPLIT\n");
+    exit(-1);
+  }
 
   auto start = wall_clock_t::now();
 
-  // Time evolution
-  for (int iter = 1; iter <= nsteps; iter++) {
-    evolve(Q, &current, &previous, a, dt);
-    if (iter % image_interval == 0) {
-      write_field(&current, iter);
+  if (nsubdomains > 0) {
+    auto queues     = subdomain_queues(Q, nsubdomains);
+    auto subdomains = decompose(queues, &previous);
+
+    // Time evolution, with the ghost rows exchanged after each time step
+    for (int iter = 1; iter <= nsteps; iter++) {
+      evolve(subdomains, &previous, a, dt, dx2, dy2);
+      if (iter % image_interval == 0) {
+        gather(subdomains, &current);
+        write_field(&current, iter);
+      }
     }
-    // Swap current field so that it will be used
-    // as previous for next iteration step
-    swap_fields(&current, &previous);
+
+    // Collect the strips for the average and the final output
+    gather(subdomains, &previous);
+    free_subdomains(subdomains);
+
+    // Average temperature for reference
+    average_temp = average(&previous);
+  } else if (use_device) {
+    // Copy the fields to the device once, before the time evolution
+    double *d_curr = allocate_device_field(Q, &current);
+    double *d_prev = allocate_device_field(Q, &previous);
+
+    // Time evolution
+    for (int iter = 1; iter <= nsteps; iter++) {
+      evolve(Q, d_curr, d_prev, &current, a, dt, dx2, dy2);
+      if (iter % image_interval == 0) {
+        copy_field_from_device(Q, d_curr, &current);
+        write_field(&current, iter);
+      }
+      // Swap the device pointers, so that the current field will be used
+      // as previous for next iteration step
+      std::swap(d_curr, d_prev);
+    }
+
+    // Average and range of the temperature for reference, computed on the
+    // device
+    auto stats   = statistics(Q, d_prev, &previous);
+    average_temp = stats.sum / (previous.nx * previous.ny);
+    printf("Temperature range: %f to %f\n", stats.min, stats.max);
+
+    // Bring the latest field back to the host for the final output
+    copy_field_from_device(Q, d_prev, &previous);
+
+    free(d_curr, Q);
+    free(d_prev, Q);
+  } else if (use_usm) {
+    // Time evolution, with no copies between the host and the device
+    for (int iter = 1; iter <= nsteps; iter++) {
+      if (amr_levels > 0 && (iter - 1) % regrid_interval == 0) {
+        regrid(Q, &amr, &previous);
+      }
+      if (!split) {
+        apply_boundaries(Q, previous.data.data(), &previous, &boundaries);
+      }
+      if (split) {
+        evolve_split(
+          split_queue,
+          current.data.data(),
+          previous.data.data(),
+          &current,
+          &boundaries,
+          a,
+          dt,
+          dx2,
+          dy2,
+          &step);
+      } else if (epsilon > 0.0) {
+        evolve_active(
+          Q,
+          current.data.data(),
+          previous.data.data(),
+          &current,
+          a,
+          dt,
+          dx2,
+          dy2,
+          &tiles);
+      } else if (amr_levels > 0) {
+        evolve_amr(Q, &amr, &current, &previous, a, dt, dx2, dy2);
+      } else if (nmaterials == 0) {
+        evolve(
+          Q,
+          current.data.data(),
+          previous.data.data(),
+          &current,
+          a,
+          dt,
+          dx2,
+          dy2);
+      } else if (per_cell) {
+        evolve_variable(
+          Q,
+          current.data.data(),
+          previous.data.data(),
+          diffusivity.data.data(),
+          &current,
+          dt,
+          dx2,
+          dy2);
+      } else {
+        evolve_materials(
+          Q,
+          current.data.data(),
+          previous.data.data(),
+          &materials,
+          &current,
+          dt,
+          dx2,
+          dy2);
+      }
+      if (iter % image_interval == 0) {
+        // the host reads the shared data once the kernels have finished
+        Q.wait();
+        split_queue.wait();
+        write_field(&current, iter);
+      }
+      // Swap current field so that it will be used
+      // as previous for next iteration step
+      swap_fields(&current, &previous);
+    }
+
+    split_queue.wait();
+
+    // Average and range of the temperature for reference, computed on the
+    // device
+    auto stats   = statistics(Q, previous.data.data(), &previous);
+    average_temp = stats.sum / (previous.nx * previous.ny);
+    printf("Temperature range: %f to %f\n", stats.min, stats.max);
+
+    for (int l = 1; l <= amr_levels; l++) {
+      printf(
+        "Refinement level %d: %d patches\n",
+        l,
+        amr.levels[l - 1].npatches);
+    }
+    if (epsilon > 0.0) {
+      printf(
+        "Tile updates computed: %ld of %ld\n",
+        tiles.computed[0],
+        static_cast<long>(nsteps) * tiles.nty * tiles.ntx);
+    }
+  } else {
+    // Time evolution
+    for (int iter = 1; iter <= nsteps; iter++) {
+      if (tiled) {
+        evolve_tiled(Q, &current, &previous, a, dt, tile);
+      } else {
+        evolve(Q, &current, &previous, a, dt);
+      }
+      if (iter % image_interval == 0) {
+        write_field(&current, iter);
+      }
+      // Swap current field so that it will be used
+      // as previous for next iteration step
+      swap_fields(&current, &previous);
+    }
+
+    // Average temperature for reference
+    average_temp = average(&previous);
   }
 
   auto stop = wall_clock_t::now();
 
-  // Average temperature for reference
-  average_temp = average(&previous);
-
   // Determine the CPU time used for all the iterations
   std::chrono::duration<float> elapsed = stop - start;
   printf("Iterations took %.3f seconds.\n", elapsed.count());
@@ -0,0 +1,211 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Heat equation solver for heterogeneous materials, where the diffusivity
+// varies from one grid cell to another
+
+#include <cassert>
+
+#include <sycl/sycl.hpp>
+
+#include "heat.h"
+
+using namespace sycl;
+
+// Diffusivity on the face between two cells, as the harmonic mean of the
+// diffusivities of the cells. This keeps the heat flux continuous across a
+// jump in the material, and an insulating cell blocks it completely.
+static inline double
+face_diffusivity(double a1, double a2)
+{
+  const double sum = a1 + a2;
+  return sum > 0.0 ? 2.0 * a1 * a2 / sum : 0.0;
+}
+
+// New temperature of a grid cell from the temperatures prev of the cell and
+// its neighbours, and from the diffusivities of the same cells
+static inline double
+variable_stencil(
+  const double prev[5],
+  const double a[5],
+  double dt,
+  double dx2,
+  double dy2)
+{
+  // The cells are in the order centre, +i, -i, +j, -j, where i runs along
+  // the rows
+  return prev[0] +
+         dt * ((face_diffusivity(a[0], a[1]) * (prev[1] - prev[0]) -
+                face_diffusivity(a[0], a[2]) * (prev[0] - prev[2])) /
+                 dx2 +
+               (face_diffusivity(a[0], a[3]) * (prev[3] - prev[0]) -
+                face_diffusivity(a[0], a[4]) * (prev[0] - prev[4])) /
+                 dy2);
+}
+
+// Generate a layered material map, with count layers of equal thickness
+// along the first dimension. The diffusivity decreases linearly from a in
+// the first layer to a / count in the last one.
+void
+generate_materials(
+  queue &Q,
+  const field *layout,
+  int count,
+  double a,
+  material_map *materials)
+{
+  assert(count > 0 && count <= MAX_MATERIALS);
+
+  materials->count = count;
+  for (int k = 0; k < count; k++) {
+    materials->diffusivity[k] = a * (count - k) / count;
+  }
+
+  // Help the compiler avoid being confused by the structs
+  const int nx    = layout->nx;
+  const int pitch = layout->pitch;
+
+  materials->index.resize((nx + 2) * pitch);
+  uint8_t *index = materials->index.data();
+
+  Q.parallel_for(range<2>(nx + 2, pitch), [=](id<2> id) {
+    index[id[0] * pitch + id[1]] =
+      static_cast<uint8_t>(id[0] * count / (nx + 2));
+  });
+  Q.wait();
+}
+
+// Expand a material map into a field holding the diffusivity of every grid
+// cell, with the dimensions and row layout of the field layout
+void
+expand_materials(
+  queue &Q,
+  const material_map *materials,
+  const field *layout,
+  field *diffusivity)
+{
+  diffusivity->nx     = layout->nx;
+  diffusivity->ny     = layout->ny;
+  diffusivity->pitch  = layout->pitch;
+  diffusivity->offset = layout->offset;
+  diffusivity->dx     = layout->dx;
+  diffusivity->dy     = layout->dy;
+  diffusivity->data.resize(materials->index.size());
+
+  const uint8_t *index = materials->index.data();
+  const auto table     = materials->diffusivity;
+  double *data         = diffusivity->data.data();
+
+  Q.parallel_for(range<1>(materials->index.size()), [=](id<1> id) {
+    data[id[0]] = table[index[id[0]]];
+  });
+  Q.wait();
+}
+
+// Update the temperature values using five-point stencil with a per-cell
+// diffusivity, with the fields held in USM allocations the device can
+// access
+// Arguments:
+//   curr: current temperature values
+//   prev: temperature values from previous time step
+//   diffusivity: diffusivity of every grid cell, ghost layers included
+//   layout: field with the dimensions and row layout of the arrays
+//   dt: time step
+void
+evolve_variable(
+  queue &Q,
+  double *curr,
+  const double *prev,
+  const double *diffusivity,
+  const field *layout,
+  double dt,
+  double dx2,
+  double dy2)
+{
+  // leading dimension of the fields
+  const int ld = layout->pitch;
+
+  const int nx     = layout->nx;
+  const int ny     = layout->ny;
+  const int offset = layout->offset;
+
+  Q.parallel_for(range<2>(nx, ny), [=](id<2> id) {
+    const int c = (id[0] + 1) * ld + offset + id[1] + 1;
+
+    const double values[5] = {
+      prev[c], prev[c + 1], prev[c - 1], prev[c + ld], prev[c - ld]
+    };
+    const double a[5] = { diffusivity[c],
+                          diffusivity[c + 1],
+                          diffusivity[c - 1],
+                          diffusivity[c + ld],
+                          diffusivity[c - ld] };
+
+    curr[c] = variable_stencil(values, a, dt, dx2, dy2);
+  });
+}
+
+// Update the temperature values using five-point stencil with the
+// diffusivities given by a material map. Each grid cell reads a single byte
+// for its material, and the table of diffusivities is passed to the kernel
+// by value, so that it is held in constant memory.
+// Arguments:
+//   curr: current temperature values
+//   prev: temperature values from previous time step
+//   materials: material map with the row layout of the fields
+//   layout: field with the dimensions and row layout of the arrays
+//   dt: time step
+void
+evolve_materials(
+  queue &Q,
+  double *curr,
+  const double *prev,
+  const material_map *materials,
+  const field *layout,
+  double dt,
+  double dx2,
+  double dy2)
+{
+  // leading dimension of the fields
+  const int ld = layout->pitch;
+
+  const int nx     = layout->nx;
+  const int ny     = layout->ny;
+  const int offset = layout->offset;
+
+  const uint8_t *index = materials->index.data();
+  const auto table     = materials->diffusivity;
+
+  Q.parallel_for(range<2>(nx, ny), [=](id<2> id) {
+    const int c = (id[0] + 1) * ld + offset + id[1] + 1;
+
+    const double values[5] = {
+      prev[c], prev[c + 1], prev[c - 1], prev[c + ld], prev[c - ld]
+    };
+    const double a[5] = { table[index[c]],
+                          table[index[c + 1]],
+                          table[index[c - 1]],
+                          table[index[c + ld]],
+                          table[index[c - ld]] };
+
+    curr[c] = variable_stencil(values, a, dt, dx2, dy2);
+  });
+}
@@ -0,0 +1,309 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Out-of-core time evolution of a field kept in a memory-mapped file
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <sycl/sycl.hpp>
+
+#include "heat.h"
+
+using namespace sycl;
+
+// Size in bytes of the rows 0, ..., i-1 of a mapped field
+static std::size_t
+row_offset(const mapped_field *temperature, int i)
+{
+  return static_cast<std::size_t>(i) * (temperature->ny + 2) * sizeof(double);
+}
+
+// First value of the row i of a mapped field
+static double *
+mapped_row(const mapped_field *temperature, int i)
+{
+  return temperature->data +
+         static_cast<std::size_t>(i) * (temperature->ny + 2);
+}
+
+// Tell the kernel how the rows i0, ..., i1-1 of a mapped field are going to
+// be used, both through the mapping and through the page cache of the file.
+// The advice only starts the reads or the write-back, it returns at once.
+static void
+advise(
+  const mapped_field *temperature,
+  int i0,
+  int i1,
+  int map_advice,
+  int file_advice)
+{
+  if (i1 <= i0) {
+    return;
+  }
+  // the range given to madvise has to start at a page boundary
+  static const std::size_t page = sysconf(_SC_PAGESIZE);
+  std::size_t begin = row_offset(temperature, i0) / page * page;
+  std::size_t end   = row_offset(temperature, i1);
+  madvise(
+    reinterpret_cast<char *>(temperature->data) + begin,
+    end - begin,
+    map_advice);
+  posix_fadvise(temperature->fd, begin, end - begin, file_advice);
+}
+
+// Map the file filename as a field of nx x ny grid points, creating the file
+// if needed. Returns true if the file did not hold a field of these
+// dimensions before, in which case its values are undefined.
+bool
+map_field(const char *filename, int nx, int ny, mapped_field *temperature)
+{
+  temperature->nx = nx;
+  temperature->ny = ny;
+  temperature->dx = DX;
+  temperature->dy = DY;
+
+  std::size_t size = row_offset(temperature, nx + 2);
+
+  temperature->fd = open(filename, O_RDWR | O_CREAT, 0644);
+  if (temperature->fd < 0) {
+    printf("Unable to open %s\n", filename);
+    exit(-1);
+  }
+
+  struct stat status;
+  fstat(temperature->fd, &status);
+  bool fresh = static_cast<std::size_t>(status.st_size) != size;
+  if (fresh && ftruncate(temperature->fd, size) != 0) {
+    printf("Unable to resize %s to %zu bytes\n", filename, size);
+    exit(-1);
+  }
+
+  void *data = mmap(
+    nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, temperature->fd, 0);
+  if (data == MAP_FAILED) {
+    printf("Unable to map %s\n", filename);
+    exit(-1);
+  }
+  temperature->data = static_cast<double *>(data);
+
+  // The file is streamed through from the first row to the last, so that
+  // the kernel can read ahead aggressively
+  madvise(data, size, MADV_SEQUENTIAL);
+  posix_fadvise(temperature->fd, 0, size, POSIX_FADV_SEQUENTIAL);
+
+  return fresh;
+}
+
+// Write the mapped field back to its file and release the mapping
+void
+unmap_field(mapped_field *temperature)
+{
+  std::size_t size = row_offset(temperature, temperature->nx + 2);
+  msync(temperature->data, size, MS_SYNC);
+  munmap(temperature->data, size);
+  close(temperature->fd);
+}
+
+// Generate the initial temperature field of generate_field, the disc with
+// a radius of nx / 6 and the constant boundary temperatures, one row at a
+// time on the host so that the field never has to fit in memory
+void
+generate_field(mapped_field *temperature)
+{
+  const int nx = temperature->nx;
+  const int ny = temperature->ny;
+
+  double radius = nx / 6.0;
+  for (int i = 0; i < nx + 2; i++) {
+    double *row = mapped_row(temperature, i);
+    for (int j = 0; j < ny + 2; j++) {
+      // distance from the origin, in 64 bits as its square overflows int
+      // for the largest grids
+      long dx = i - nx / 2 + 1;
+      long dy = j - ny / 2 + 1;
+      if (i == 0) {
+        row[j] = 85.0;
+      } else if (i == nx + 1) {
+        row[j] = 5.0;
+      } else if (j == 0) {
+        row[j] = 20.0;
+      } else if (j == ny + 1) {
+        row[j] = 70.0;
+      } else if (dx * dx + dy * dy < radius * radius) {
+        row[j] = 5.0;
+      } else {
+        row[j] = 65.0;
+      }
+    }
+  }
+}
+
+// Calculate average temperature over the non-boundary grid cells, streaming
+// through the rows in the same order as average does for a field
+double
+average(const mapped_field *temperature)
+{
+  double average = 0.0;
+
+  for (int i = 1; i < temperature->nx + 1; i++) {
+    const double *row = mapped_row(temperature, i);
+    for (int j = 1; j < temperature->ny + 1; j++) {
+      average += row[j];
+    }
+  }
+
+  average /= (static_cast<double>(temperature->nx) * temperature->ny);
+  return average;
+}
+
+// Take nsteps time steps of the five-point stencil on a mapped field, with
+// only slabs of it in device memory. Each pass over the file advances the
+// field by block time steps: the slabs of slab rows are copied in turn to
+// the device with block ghost rows on both sides, and the window shrinks by
+// a row at both ends per time step so that the slab itself is up to date
+// at the end. The rows above the slab still hold the values before the
+// pass, as the previous slab keeps a device copy of its last rows before
+// the update, and the rows below have not been written yet. Every slab is
+// thus read and written once per block time steps.
+// While a slab is updated, the rows of the next one are prefetched, and the
+// write-back of the slab is started as soon as it has been written.
+// Arguments:
+//   temperature: the mapped field, updated in place
+//   nsteps: number of time steps
+//   slab: number of rows per slab
+//   block: number of time steps per pass over the file
+//   a: diffusivity
+//   dt: time step
+void
+evolve_out_of_core(
+  queue &Q,
+  mapped_field *temperature,
+  int nsteps,
+  int slab,
+  int block,
+  double a,
+  double dt,
+  double dx2,
+  double dy2)
+{
+  const int nx = temperature->nx;
+  const int ny = temperature->ny;
+
+  // leading dimension of the field and of the windows
+  const int ld = ny + 2;
+
+  slab  = std::clamp(slab, 1, nx);
+  block = std::max(block, 1);
+
+  // the window of a slab, and the rows kept for the next one
+  const std::size_t window = static_cast<std::size_t>(slab + 2 * block) * ld;
+  double *curr  = malloc_device<double>(window, Q);
+  double *prev  = malloc_device<double>(window, Q);
+  double *carry = malloc_device<double>(block * ld, Q);
+
+  for (int iter = 0; iter < nsteps; iter += block) {
+    const int k = std::min(block, nsteps - iter);
+
+    for (int r0 = 1; r0 <= nx; r0 += slab) {
+      // the slab is the rows r0, ..., r1-1, and the window the rows w0, ...,
+      // w1-1. The ghost layers of the field are never updated, so the
+      // window ends there without extra rows.
+      const int r1 = std::min(r0 + slab, nx + 1);
+      const int w0 = std::max(0, r0 - k);
+      const int w1 = std::min(nx + 2, r1 + k);
+
+      // Prefetch the rows the next slab reads from the file, or the first
+      // slab of the next pass
+      if (w1 < nx + 2) {
+        advise(
+          temperature,
+          w1,
+          std::min(nx + 2, w1 + slab),
+          MADV_WILLNEED,
+          POSIX_FADV_WILLNEED);
+      } else if (iter + k < nsteps) {
+        advise(
+          temperature,
+          0,
+          std::min(nx + 2, 1 + slab + block),
+          MADV_WILLNEED,
+          POSIX_FADV_WILLNEED);
+      }
+
+      // The rows above the slab come from the carry, except for the first
+      // slab, and the rest from the file
+      const int from_file = r0 == 1 ? w0 : r0;
+      Q.copy(carry, curr, (from_file - w0) * ld);
+      Q.copy(
+        mapped_row(temperature, from_file),
+        curr + (from_file - w0) * ld,
+        static_cast<std::size_t>(w1 - from_file) * ld);
+
+      // Keep the last rows of the slab, which the next window starts with,
+      // before they are updated
+      const int c0 = std::max(0, r1 - k);
+      Q.copy(curr + (c0 - w0) * ld, carry, (r1 - c0) * ld);
+
+      // Both fields hold the rows and ghost layers that are not updated
+      Q.copy(curr, prev, static_cast<std::size_t>(w1 - w0) * ld);
+
+      for (int step = 1; step <= k; step++) {
+        // rows updated in this time step
+        const int lo = w0 == 0 ? 1 : w0 + step;
+        const int hi = w1 == nx + 2 ? nx + 1 : w1 - step;
+
+        double *dst       = step % 2 ? prev : curr;
+        const double *src = step % 2 ? curr : prev;
+
+        Q.parallel_for(range<2>(hi - lo, ny), [=](id<2> id) {
+          const int c = (lo - w0 + id[0]) * ld + id[1] + 1;
+
+          dst[c] =
+            src[c] +
+            a * dt *
+              ((src[c + 1] - 2.0 * src[c] + src[c - 1]) / dx2 +
+               (src[c + ld] - 2.0 * src[c] + src[c - ld]) / dy2);
+        });
+      }
+
+      const double *result = k % 2 ? prev : curr;
+      Q.copy(
+        result + (r0 - w0) * ld,
+        mapped_row(temperature, r0),
+        static_cast<std::size_t>(r1 - r0) * ld);
+      Q.wait();
+
+      // The slab is not needed again in this pass
+      advise(temperature, r0, r1, MADV_DONTNEED, POSIX_FADV_DONTNEED);
+    }
+  }
+
+  free(curr, Q);
+  free(prev, Q);
+  free(carry, Q);
+}
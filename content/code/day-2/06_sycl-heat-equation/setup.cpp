@@ -22,6 +22,7 @@
 /* Setup routines for heat equation solver */
 
 #include <cassert>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -31,9 +32,22 @@
 // Default number of iteration steps
 constexpr auto NSTEPS = 500;
 
+// Registry of the initial conditions that generate_field can produce
+static const initial_condition initial_conditions[] = {
+  { "disc", initial_pattern::disc, 6.0, 5.0, 65.0 },
+  { "gaussian", initial_pattern::gaussian, 6.0, 5.0, 65.0 },
+  { "random", initial_pattern::random, 6.0, 5.0, 65.0 },
+};
+
 /* Initialize the heat equation solver */
 void
-initialize(int argc, char *argv[], field *current, field *previous, int *nsteps)
+initialize(
+  sycl::queue &Q,
+  int argc,
+  char *argv[],
+  field *current,
+  field *previous,
+  int *nsteps)
 {
   /*
    * Following combinations of command line arguments are possible:
@@ -52,6 +66,10 @@ initialize(int argc, char *argv[], field *current, field *previous, int *nsteps)
 
   *nsteps = NSTEPS;
 
+  // Start every row of the interior on a boundary of this many bytes, or
+  // pack the rows back to back if it is no more than the size of a value
+  int alignment = parameter_from_env("HEAT_ALIGNMENT", 64);
+
   switch (argc) {
     case 1:
       /* Use default values */
@@ -82,68 +100,231 @@ initialize(int argc, char *argv[], field *current, field *previous, int *nsteps)
   }
 
   if (read_file) {
-    read_field(current, previous, input_file);
+    read_field(current, previous, input_file, alignment);
   } else {
-    set_field_dimensions(current, rows, cols);
-    set_field_dimensions(previous, rows, cols);
-    generate_field(current);
-    allocate_field(previous);
-    copy_field(current, previous);
+    set_field_dimensions(current, rows, cols, alignment);
+    set_field_dimensions(previous, rows, cols, alignment);
+    // Initial condition, chosen by name, and the seed of the random one
+    const char *name = getenv("HEAT_INITIAL");
+    const initial_condition *condition =
+      find_initial_condition(name != nullptr ? name : "disc");
+    unsigned seed = parameter_from_env("HEAT_SEED", 0);
+
+    // Generate both fields on the device, so that the host never touches
+    // their memory during the setup
+    generate_field(Q, current, condition, seed);
+    generate_field(Q, previous, condition, seed);
+  }
+}
+
+/* Look up an initial condition from the registry by its name */
+const initial_condition *
+find_initial_condition(const char *name)
+{
+  for (const auto &condition : initial_conditions) {
+    if (strcmp(condition.name, name) == 0) {
+      return &condition;
+    }
+  }
+
+  printf("Unknown initial condition %s, available ones are:", name);
+  for (const auto &condition : initial_conditions) {
+    printf(" %s", condition.name);
   }
+  printf("\n");
+  exit(-1);
+}
+
+/* Uniformly distributed value in [0, 1) for the grid point (i, j), from an
+ * integer hash of the indices and the seed */
+static double
+hash_uniform(uint32_t i, uint32_t j, uint32_t seed)
+{
+  uint32_t h = seed ^ (i * 0x9e3779b1u) ^ (j * 0x85ebca77u);
+  h ^= h >> 16;
+  h *= 0x7feb352du;
+  h ^= h >> 15;
+  h *= 0x846ca68bu;
+  h ^= h >> 16;
+  return h / 4294967296.0;
 }
 
-/* Generate initial temperature field.  Pattern is disc with a radius
- * of nx / 6 in the center of the grid.
- * Boundary conditions are (different) constant temperatures outside the grid */
+/* Generate initial temperature field in parallel on the device. The
+ * interior follows the pattern of the initial condition, e.g. a disc with a
+ * radius of nx / 6 in the center of the grid.
+ * Boundary conditions are (different) constant temperatures outside the grid.
+ * The data is allocated without touching it from the host, and the kernel
+ * writes every value, including the padding at the ends of the rows. */
 void
-generate_field(field *temperature)
+generate_field(
+  sycl::queue &Q,
+  field *temperature,
+  const initial_condition *condition,
+  unsigned seed)
 {
-  int ind;
-  double radius;
-  int dx, dy;
+  // Help the compiler avoid being confused by the structs
+  const int nx     = temperature->nx;
+  const int ny     = temperature->ny;
+  const int pitch  = temperature->pitch;
+  const int offset = temperature->offset;
+
+  const auto pattern = condition->pattern;
+  const auto inside  = condition->inside;
+  const auto outside = condition->outside;
+  /* Radius of the pattern */
+  const double radius = nx / condition->scale;
 
   /* Allocate the temperature array, note that
    * we have to allocate also the ghost layers */
-  int newSize = (temperature->nx + 2) * (temperature->ny + 2);
-  temperature->data.resize(newSize, 0.0);
-
-  /* Radius of the source disc */
-  radius = temperature->nx / 6.0;
-  for (int i = 0; i < temperature->nx + 2; i++) {
-    for (int j = 0; j < temperature->ny + 2; j++) {
-      ind = i * (temperature->ny + 2) + j;
+  temperature->data.resize((nx + 2) * pitch);
+  double *data = temperature->data.data();
+
+  Q.parallel_for(sycl::range<2>(nx + 2, pitch), [=](sycl::id<2> id) {
+    const int i = id[0];
+    // column of the grid point, counting the ghost layer as 0
+    const int j = static_cast<int>(id[1]) - offset;
+
+    double value = 0.0;
+    if (j < 0 || j > ny + 1) {
+      // padding at the ends of the rows, which stays zero
+    } else if (i == 0) {
+      value = 85.0;
+    } else if (i == nx + 1) {
+      value = 5.0;
+    } else if (j == 0) {
+      value = 20.0;
+    } else if (j == ny + 1) {
+      value = 70.0;
+    } else {
       /* Distance of point i, j from the origin */
-      dx = i - temperature->nx / 2 + 1;
-      dy = j - temperature->ny / 2 + 1;
-      if (dx * dx + dy * dy < radius * radius) {
-        temperature->data[ind] = 5.0;
-      } else {
-        temperature->data[ind] = 65.0;
+      const int dx = i - nx / 2 + 1;
+      const int dy = j - ny / 2 + 1;
+      const int d2 = dx * dx + dy * dy;
+      switch (pattern) {
+        case initial_pattern::disc:
+          value = d2 < radius * radius ? inside : outside;
+          break;
+        case initial_pattern::gaussian:
+          value = outside + (inside - outside) *
+                              sycl::exp(-d2 / (2.0 * radius * radius));
+          break;
+        case initial_pattern::random:
+          value = inside + (outside - inside) * hash_uniform(i, j, seed);
+          break;
       }
     }
-  }
-
-  /* Boundary conditions */
-  for (int i = 0; i < temperature->nx + 2; i++) {
-    temperature->data[i * (temperature->ny + 2)]                       = 20.0;
-    temperature->data[i * (temperature->ny + 2) + temperature->ny + 1] = 70.0;
-  }
-
-  for (int j = 0; j < temperature->ny + 2; j++) {
-    temperature->data[j] = 85.0;
-  }
-  for (int j = 0; j < temperature->ny + 2; j++) {
-    temperature->data[(temperature->nx + 1) * (temperature->ny + 2) + j] = 5.0;
-  }
+    data[id[0] * pitch + id[1]] = value;
+  });
+  Q.wait();
 }
 
 /* Set dimensions of the field. Note that the nx is the size of the first
- * dimension and ny the second. */
+ * dimension and ny the second.
+ * The rows are padded so that the first interior value of each row starts
+ * on a boundary of alignment bytes, which has to be a power of two no larger
+ * than FIELD_ALIGNMENT. */
 void
-set_field_dimensions(field *temperature, int nx, int ny)
+set_field_dimensions(field *temperature, int nx, int ny, int alignment)
 {
+  if (
+    alignment < 0 || alignment > static_cast<int>(FIELD_ALIGNMENT) ||
+    (alignment & (alignment - 1)) != 0) {
+    printf(
+      "HEAT_ALIGNMENT has to be a power of two no larger than %d, not %d\n",
+      static_cast<int>(FIELD_ALIGNMENT),
+      alignment);
+    exit(-1);
+  }
+
   temperature->dx = DX;
   temperature->dy = DY;
   temperature->nx = nx;
   temperature->ny = ny;
+
+  // alignment in units of values
+  int values = alignment / static_cast<int>(sizeof(double));
+  if (values > 1) {
+    // the data starts on an aligned address, so the offset puts the value
+    // following the ghost value on the next aligned address
+    temperature->offset = values - 1;
+    temperature->pitch =
+      (temperature->offset + ny + 2 + values - 1) / values * values;
+  } else {
+    temperature->offset = 0;
+    temperature->pitch  = ny + 2;
+  }
+}
+
+/* Read an integer tuning parameter from the environment variable name.
+ * The fallback value is returned if the variable is not set. */
+int
+parameter_from_env(const char *name, int fallback)
+{
+  const char *value = getenv(name);
+  if (value == nullptr) {
+    return fallback;
+  }
+  return atoi(value);
+}
+
+/* Read a floating-point tuning parameter from the environment variable name.
+ * The fallback value is returned if the variable is not set. */
+double
+parameter_from_env(const char *name, double fallback)
+{
+  const char *value = getenv(name);
+  if (value == nullptr) {
+    return fallback;
+  }
+  return atof(value);
+}
+
+/* Read the boundary conditions from the environment variable HEAT_BOUNDARY,
+ * which holds one letter for each side, in the order i = 0, i = nx+1, j = 0
+ * and j = ny+1: D for a Dirichlet boundary, which keeps the temperatures
+ * given to its ghost layer by generate_field or read_field, N for an
+ * insulated Neumann boundary and P for a periodic one. All the boundaries
+ * are Dirichlet ones by default. */
+boundary_conditions
+boundary_conditions_from_env()
+{
+  const char *value = getenv("HEAT_BOUNDARY");
+  if (value == nullptr) {
+    value = "DDDD";
+  }
+  if (strlen(value) != 4) {
+    printf("HEAT_BOUNDARY needs one letter for each of the four sides\n");
+    exit(-1);
+  }
+
+  boundary_conditions conditions;
+  for (int side = 0; side < 4; side++) {
+    switch (value[side]) {
+      case 'D':
+        conditions.side[side] = { boundary_kind::dirichlet, 0.0 };
+        break;
+      case 'N':
+        conditions.side[side] = { boundary_kind::neumann, 0.0 };
+        break;
+      case 'P':
+        conditions.side[side] = { boundary_kind::periodic, 0.0 };
+        break;
+      default:
+        printf("Unknown boundary condition %c, use D, N or P\n", value[side]);
+        exit(-1);
+    }
+  }
+
+  // a periodic side wraps around to the opposite one, which has to be
+  // periodic as well
+  for (int side = 0; side < 4; side += 2) {
+    if (
+      (conditions.side[side].kind == boundary_kind::periodic) !=
+      (conditions.side[side + 1].kind == boundary_kind::periodic)) {
+      printf("Periodic boundaries have to be on opposite sides\n");
+      exit(-1);
+    }
+  }
+
+  return conditions;
 }
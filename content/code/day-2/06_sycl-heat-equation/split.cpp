@@ -0,0 +1,131 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Time step split into kernels for the interior and the edges of the field
+
+#include <algorithm>
+
+#include <sycl/sycl.hpp>
+
+#include "heat.h"
+
+using namespace sycl;
+
+// Five-point stencil at the grid point c, ld being the leading dimension
+static inline void
+update(
+  double *curr,
+  const double *prev,
+  int c,
+  int ld,
+  double a,
+  double dt,
+  double dx2,
+  double dy2)
+{
+  curr[c] =
+    prev[c] +
+    a * dt *
+      ((prev[c + 1] - 2.0 * prev[c] + prev[c - 1]) / dx2 +
+       (prev[c + ld] - 2.0 * prev[c] + prev[c - ld]) / dy2);
+}
+
+// Take one time step of the five-point stencil on a field held in USM
+// allocations, as three kernels on an out-of-order queue:
+//   1. the ghost layers of prev are refreshed once the edges of the
+//      previous time step are done
+//   2. the interior, all but the first and last rows and columns, is
+//      updated once the previous time step is done. It does not read the
+//      ghost layers, so it runs alongside the other two kernels.
+//   3. the edges are updated once the ghost layers are refreshed and the
+//      interior of the previous time step is done
+// Only the events of the previous time step are waited for, so the bulk of
+// the work can start before the thin kernels around it have finished, and
+// copies or reductions of the edges can be chained to step->edges.
+// Arguments:
+//   curr: current temperature values
+//   prev: temperature values from previous time step
+//   layout: field with the dimensions and row layout of curr and prev
+//   conditions: boundary conditions of the four sides
+//   a: diffusivity
+//   dt: time step
+//   step: the events of the previous time step, replaced by those of this
+//     one
+void
+evolve_split(
+  queue &Q,
+  double *curr,
+  double *prev,
+  const field *layout,
+  const boundary_conditions *conditions,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  split_step *step)
+{
+  // leading dimension of the fields
+  const int ld = layout->pitch;
+
+  const int nx     = layout->nx;
+  const int ny     = layout->ny;
+  const int offset = layout->offset;
+
+  // number of interior rows in the columns at both sides
+  const int ncolumn = std::max(nx - 2, 0);
+
+  auto ghosts = apply_boundaries(Q, prev, layout, conditions, { step->edges });
+
+  range<2> interior { static_cast<size_t>(ncolumn),
+                      static_cast<size_t>(std::max(ny - 2, 0)) };
+  auto inner = Q.submit([&](handler &cgh) {
+    cgh.depends_on({ step->interior, step->edges });
+    cgh.parallel_for(interior, [=](id<2> id) {
+      const int c = (id[0] + 2) * ld + offset + id[1] + 2;
+      update(curr, prev, c, ld, a, dt, dx2, dy2);
+    });
+  });
+
+  // The edges are enumerated as the first and last rows followed by the
+  // first and last columns without their ends. With a single row or column
+  // the same points are updated twice, to the same value.
+  size_t nedges = 2 * ny + 2 * ncolumn;
+  auto edges    = Q.submit([&](handler &cgh) {
+    // the ghosts event does not wait for step->edges when no ghost layer
+    // needs refreshing
+    cgh.depends_on({ ghosts, step->interior, step->edges });
+    cgh.parallel_for(range<1>(nedges), [=](id<1> id) {
+      int k = id[0];
+      int i, j;
+      if (k < 2 * ny) {
+        i = k < ny ? 1 : nx;
+        j = k % ny + 1;
+      } else {
+        k -= 2 * ny;
+        i = k % ncolumn + 2;
+        j = k < ncolumn ? 1 : ny;
+      }
+      update(curr, prev, i * ld + offset + j, ld, a, dt, dx2, dy2);
+    });
+  });
+
+  *step = { ghosts, inner, edges };
+}
@@ -23,15 +23,21 @@
 
 #include <cassert>
 #include <cstdlib>
+#include <limits>
+
+#include <sycl/sycl.hpp>
 
 #include "heat.h"
 
+using namespace sycl;
+
 // Copy data on temperature1 into temperature2
 void
 copy_field(field *temperature1, field *temperature2)
 {
   assert(temperature1->nx == temperature2->nx);
   assert(temperature1->ny == temperature2->ny);
+  assert(temperature1->pitch == temperature2->pitch);
   assert(temperature1->data.size() == temperature2->data.size());
   std::copy(
     temperature1->data.begin(),
@@ -51,7 +57,7 @@ void
 allocate_field(field *temperature)
 {
   // Include also boundary layers
-  int newSize = (temperature->nx + 2) * (temperature->ny + 2);
+  int newSize = (temperature->nx + 2) * temperature->pitch;
   temperature->data.resize(newSize, 0.0);
 }
 
@@ -63,7 +69,7 @@ average(field *temperature)
 
   for (int i = 1; i < temperature->nx + 1; i++) {
     for (int j = 1; j < temperature->ny + 1; j++) {
-      int ind = i * (temperature->ny + 2) + j;
+      int ind = field_index(temperature, i, j);
       average += temperature->data[ind];
     }
   }
@@ -71,3 +77,97 @@ average(field *temperature)
   average /= (temperature->nx * temperature->ny);
   return average;
 }
+
+// Allocate device memory for a temperature field, including the boundary
+// layers, and copy the field data to it. The device copy keeps the row
+// layout of the field, so its rows are aligned in the same way.
+double *
+allocate_device_field(queue &Q, field *temperature)
+{
+  auto size   = temperature->data.size();
+  auto d_data = aligned_alloc_device<double>(FIELD_ALIGNMENT, size, Q);
+  Q.copy(temperature->data.data(), d_data, size).wait();
+  return d_data;
+}
+
+// Copy the temperature field data from device memory back to the host
+void
+copy_field_from_device(queue &Q, const double *d_data, field *temperature)
+{
+  Q.copy(d_data, temperature->data.data(), temperature->data.size()).wait();
+}
+
+// Calculate sum, minimum and maximum of the temperature over the
+// non-boundary grid cells of a field whose data the device can access,
+// either in device memory or in the shared field data.
+// Each work-item sums one row with compensated (Kahan) summation and the
+// row sums are then combined by the reduction, so that the result does not
+// depend on rounding errors piling up along the rows. Only the three
+// scalars are copied back to the host.
+field_statistics
+statistics(queue &Q, const double *d_data, const field *layout)
+{
+  // Help the compiler avoid being confused by the structs
+  const int nx     = layout->nx;
+  const int ny     = layout->ny;
+  const int pitch  = layout->pitch;
+  const int offset = layout->offset;
+
+  field_statistics stats { 0.0,
+                           std::numeric_limits<double>::max(),
+                           std::numeric_limits<double>::lowest() };
+
+  // the reduction variables live in device memory
+  auto d_stats = malloc_device<field_statistics>(1, Q);
+  Q.copy(&stats, d_stats, 1).wait();
+
+  Q.submit([&](handler &cgh) {
+    auto sum_red = reduction(&d_stats->sum, plus<double>());
+    auto min_red = reduction(&d_stats->min, minimum<double>());
+    auto max_red = reduction(&d_stats->max, maximum<double>());
+
+    cgh.parallel_for(
+      range<1>(nx),
+      sum_red,
+      min_red,
+      max_red,
+      [=](id<1> id, auto &sum, auto &min, auto &max) {
+        const int j = id[0] + 1;
+
+        double row_sum = 0.0;
+        // running compensation for the low-order bits lost in row_sum
+        double c       = 0.0;
+        double row_min = std::numeric_limits<double>::max();
+        double row_max = std::numeric_limits<double>::lowest();
+        for (int i = 1; i < ny + 1; i++) {
+          const double value = d_data[j * pitch + offset + i];
+
+          const double y = value - c;
+          const double t = row_sum + y;
+          c              = (t - row_sum) - y;
+          row_sum        = t;
+
+          row_min = sycl::fmin(row_min, value);
+          row_max = sycl::fmax(row_max, value);
+        }
+
+        sum += row_sum;
+        min.combine(row_min);
+        max.combine(row_max);
+      });
+  }).wait();
+
+  Q.copy(d_stats, &stats, 1).wait();
+
+  free(d_stats, Q);
+
+  return stats;
+}
+
+// Calculate average temperature over the non-boundary grid cells of a field
+// on the device
+double
+average(queue &Q, const double *d_data, const field *layout)
+{
+  return statistics(Q, d_data, layout).sum / (layout->nx * layout->ny);
+}
@@ -0,0 +1,294 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Alternating-direction implicit time integration for heat equation solver
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+
+#include "heat.h"
+
+using namespace sycl;
+
+// Index into a 2D buffer of lines, with the unknowns of each line running
+// along dimension axis
+static inline id<2>
+line_index(int axis, size_t line, size_t k)
+{
+  return axis == 1 ? id<2>(line, k) : id<2>(k, line);
+}
+
+// Solve a batch of tridiagonal systems sharing the same constant-coefficient
+// matrix
+//   lower * x[k - 1] + diag * x[k] + upper * x[k + 1] = d[k],  k = 0..n-1
+// with one system per line of the buffer d.
+// The solver first takes npcr steps of parallel cyclic reduction (PCR). Each
+// step halves the coupling between unknowns of a line and doubles the number
+// of independent systems, at the price of one pass over d. The remaining
+// 2^npcr interleaved systems per line are then solved with the Thomas
+// algorithm, one work-item per system. Without PCR there is one work-item
+// per line, which leaves too little parallelism for long lines. The matrix
+// is the same for all lines, so its factorization is done on the host and
+// only the right-hand sides are processed on the device.
+// Arguments:
+//   d: right-hand sides on entry, solutions on exit
+//   scratch: buffer with the same range as d
+//   axis: dimension of d along which the unknowns of a line run
+//   lower, diag, upper: the matrix coefficients
+//   npcr: number of PCR steps, negative to pick one based on the line length
+void
+solve_tridiagonal(
+  queue &Q,
+  buffer<double, 2> &d,
+  buffer<double, 2> &scratch,
+  int axis,
+  double lower,
+  double diag,
+  double upper,
+  int npcr)
+{
+  const int n = d.get_range()[axis];
+
+  if (npcr < 0) {
+    // reduce until the systems solved with the Thomas algorithm have at most
+    // 64 unknowns
+    npcr = 0;
+    while ((n >> npcr) > 64) {
+      npcr++;
+    }
+  }
+
+  // matrix coefficients of the current reduced systems
+  std::vector<double> a(n, lower), b(n, diag), c(n, upper);
+  a[0]     = 0.0;
+  c[n - 1] = 0.0;
+
+  // parallel cyclic reduction
+  int stride = 1;
+  for (int level = 0; level < npcr && stride < n; level++, stride *= 2) {
+    std::vector<double> alpha(n), gamma(n);
+    std::vector<double> a_new(n), b_new(n), c_new(n);
+    for (int k = 0; k < n; k++) {
+      alpha[k] = k - stride >= 0 ? -a[k] / b[k - stride] : 0.0;
+      gamma[k] = k + stride < n ? -c[k] / b[k + stride] : 0.0;
+      a_new[k] = k - stride >= 0 ? alpha[k] * a[k - stride] : 0.0;
+      c_new[k] = k + stride < n ? gamma[k] * c[k + stride] : 0.0;
+      b_new[k] = b[k] + (k - stride >= 0 ? alpha[k] * c[k - stride] : 0.0) +
+                 (k + stride < n ? gamma[k] * a[k + stride] : 0.0);
+    }
+
+    {
+      buffer<double, 1> buf_alpha { alpha.data(), range<1>(n) },
+        buf_gamma { gamma.data(), range<1>(n) };
+
+      Q.submit([&](handler &cgh) {
+        auto acc_alpha = accessor(buf_alpha, cgh, read_only);
+        auto acc_gamma = accessor(buf_gamma, cgh, read_only);
+        auto acc_src   = accessor(d, cgh, read_only);
+        auto acc_dst   = accessor(scratch, cgh, write_only, no_init);
+
+        const int s = stride;
+        cgh.parallel_for(d.get_range(), [=](id<2> id) {
+          const int k     = id[axis];
+          const auto line = id[1 - axis];
+
+          double value = acc_src[id];
+          if (k - s >= 0) {
+            value += acc_alpha[k] * acc_src[line_index(axis, line, k - s)];
+          }
+          if (k + s < n) {
+            value += acc_gamma[k] * acc_src[line_index(axis, line, k + s)];
+          }
+          acc_dst[id] = value;
+        });
+      });
+    }
+
+    std::swap(d, scratch);
+    a = std::move(a_new);
+    b = std::move(b_new);
+    c = std::move(c_new);
+  }
+
+  // Factorize the reduced systems: the unknowns k, k + stride, k + 2 stride,
+  // ... form one system
+  std::vector<double> c_prime(n), inv_denom(n);
+  for (int k = 0; k < n; k++) {
+    if (k - stride < 0) {
+      inv_denom[k] = 1.0 / b[k];
+    } else {
+      inv_denom[k] = 1.0 / (b[k] - a[k] * c_prime[k - stride]);
+    }
+    c_prime[k] = c[k] * inv_denom[k];
+  }
+
+  {
+    buffer<double, 1> buf_a { a.data(), range<1>(n) },
+      buf_c_prime { c_prime.data(), range<1>(n) },
+      buf_inv_denom { inv_denom.data(), range<1>(n) };
+
+    const auto nlines = d.get_range()[1 - axis];
+    const auto nsys   = static_cast<size_t>(std::min(stride, n));
+
+    Q.submit([&](handler &cgh) {
+      auto acc_a         = accessor(buf_a, cgh, read_only);
+      auto acc_c_prime   = accessor(buf_c_prime, cgh, read_only);
+      auto acc_inv_denom = accessor(buf_inv_denom, cgh, read_only);
+      auto acc_d         = accessor(d, cgh, read_write);
+
+      const int s = stride;
+      cgh.parallel_for(range<2>(nlines, nsys), [=](id<2> id) {
+        const auto line = id[0];
+        const int first = id[1];
+
+        // forward elimination
+        double y = acc_d[line_index(axis, line, first)] * acc_inv_denom[first];
+        acc_d[line_index(axis, line, first)] = y;
+        int k = first;
+        for (k = first + s; k < n; k += s) {
+          auto idx   = line_index(axis, line, k);
+          y          = (acc_d[idx] - acc_a[k] * y) * acc_inv_denom[k];
+          acc_d[idx] = y;
+        }
+
+        // back substitution
+        k -= s;
+        double x = acc_d[line_index(axis, line, k)];
+        for (k -= s; k >= first; k -= s) {
+          auto idx   = line_index(axis, line, k);
+          x          = acc_d[idx] - acc_c_prime[k] * x;
+          acc_d[idx] = x;
+        }
+      });
+    });
+  }
+}
+
+// Advance the temperature values by one step of the Peaceman-Rachford
+// alternating-direction implicit (ADI) scheme.
+// The first half step is implicit along the rows and explicit along the
+// columns, the second half step the other way around. Each half step solves
+// one tridiagonal system per row, respectively per column, of the grid. The
+// scheme is unconditionally stable and second-order accurate in time, so the
+// time step is only limited by accuracy.
+// Arguments:
+//   curr: temperature values after the time step
+//   prev: temperature values before the time step
+//   work: buffer for the intermediate values, with the same dimensions and
+//     boundary values as curr and prev
+//   rhs, scratch: buffers of the size of the interior of the grid
+//   a: diffusivity
+//   dt: time step
+//   npcr: number of PCR steps in the tridiagonal solver, negative for
+//     automatic
+void
+evolve_adi(
+  queue &Q,
+  buffer<double, 2> &curr,
+  buffer<double, 2> &prev,
+  buffer<double, 2> &work,
+  buffer<double, 2> &rhs,
+  buffer<double, 2> &scratch,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  int npcr)
+{
+  auto nx = curr.get_range()[0] - 2;
+  auto ny = curr.get_range()[1] - 2;
+
+  // diffusion numbers for half a time step along the two dimensions
+  const double rx = a * dt / (2.0 * dx2);
+  const double ry = a * dt / (2.0 * dy2);
+
+  // first half step: implicit along dimension 1
+  Q.submit([&](handler &cgh) {
+    auto acc_prev = accessor(prev, cgh, read_only);
+    auto acc_rhs  = accessor(rhs, cgh, write_only, no_init);
+
+    cgh.parallel_for(range<2>(nx, ny), [=](id<2> id) {
+      auto j = id[0] + 1;
+      auto i = id[1] + 1;
+
+      double value =
+        acc_prev[j][i] +
+        ry * (acc_prev[j + 1][i] - 2.0 * acc_prev[j][i] + acc_prev[j - 1][i]);
+      // the boundary values are known and move to the right-hand side
+      if (i == 1) {
+        value += rx * acc_prev[j][0];
+      }
+      if (i == ny) {
+        value += rx * acc_prev[j][ny + 1];
+      }
+      acc_rhs[id] = value;
+    });
+  });
+
+  solve_tridiagonal(Q, rhs, scratch, 1, -rx, 1.0 + 2.0 * rx, -rx, npcr);
+
+  // second half step: implicit along dimension 0
+  Q.submit([&](handler &cgh) {
+    auto acc_half = accessor(rhs, cgh, read_only);
+    auto acc_work = accessor(work, cgh, write_only);
+
+    cgh.parallel_for(range<2>(nx, ny), [=](id<2> id) {
+      acc_work[id[0] + 1][id[1] + 1] = acc_half[id];
+    });
+  });
+
+  Q.submit([&](handler &cgh) {
+    auto acc_work = accessor(work, cgh, read_only);
+    auto acc_rhs  = accessor(rhs, cgh, write_only, no_init);
+
+    cgh.parallel_for(range<2>(nx, ny), [=](id<2> id) {
+      auto j = id[0] + 1;
+      auto i = id[1] + 1;
+
+      double value =
+        acc_work[j][i] +
+        rx * (acc_work[j][i + 1] - 2.0 * acc_work[j][i] + acc_work[j][i - 1]);
+      // the boundary values are known and move to the right-hand side
+      if (j == 1) {
+        value += ry * acc_work[0][i];
+      }
+      if (j == nx) {
+        value += ry * acc_work[nx + 1][i];
+      }
+      acc_rhs[id] = value;
+    });
+  });
+
+  solve_tridiagonal(Q, rhs, scratch, 0, -ry, 1.0 + 2.0 * ry, -ry, npcr);
+
+  Q.submit([&](handler &cgh) {
+    auto acc_new  = accessor(rhs, cgh, read_only);
+    auto acc_curr = accessor(curr, cgh, write_only);
+
+    cgh.parallel_for(range<2>(nx, ny), [=](id<2> id) {
+      acc_curr[id[0] + 1][id[1] + 1] = acc_new[id];
+    });
+  });
+}
@@ -0,0 +1,344 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Implicit time integration with matrix-free conjugate gradients for heat
+// equation solver
+
+#include <cmath>
+#include <cstdio>
+#include <utility>
+
+#include <sycl/sycl.hpp>
+
+#include "heat.h"
+
+using namespace sycl;
+
+// Coefficients of the implicit operator A = I - theta * a * dt * Laplacian
+// for the five-point stencil
+struct implicit_operator
+{
+  // off-diagonal couplings along the second and first dimension
+  double cx;
+  double cy;
+  double diag;
+};
+
+// Allocate the work space of the conjugate gradient solver for fields of the
+// given extent, ghost layers included. All fields start out as zero, and the
+// solver only ever writes their interior, so that the ghost layers implement
+// homogeneous boundary conditions for the search directions.
+cg_workspace
+allocate_cg_workspace(queue &Q, range<2> extent)
+{
+  cg_workspace work { buffer<double, 2>(extent), buffer<double, 2>(extent),
+                      buffer<double, 2>(extent), buffer<double, 2>(extent),
+                      buffer<double, 2>(extent) };
+
+  for (auto *data : { &work.r, &work.z, &work.p, &work.p_next, &work.q }) {
+    Q.submit([&](handler &cgh) {
+      auto acc = accessor(*data, cgh, write_only, no_init);
+      cgh.parallel_for(extent, [=](id<2> id) {
+        acc[id] = 0.0;
+      });
+    });
+  }
+
+  return work;
+}
+
+// Apply the Chebyshev polynomial preconditioner, i.e. take a fixed number of
+// Chebyshev iterations on A z = r starting from z = 0. The eigenvalues of A
+// lie in [1, diag + 2 * (cx + cy)], so no estimates are needed.
+// The iterate ping-pongs between z and q, and p_next holds the update, both
+// of which are free at this point of the conjugate gradient iteration.
+static void
+apply_chebyshev(queue &Q, cg_workspace &work, implicit_operator A, int degree)
+{
+  const int nx = work.r.get_range()[0] - 2;
+  const int ny = work.r.get_range()[1] - 2;
+
+  const double lambda_min = 1.0;
+  const double lambda_max = A.diag + 2.0 * (A.cx + A.cy);
+  const double center     = 0.5 * (lambda_max + lambda_min);
+  const double half_width = 0.5 * (lambda_max - lambda_min);
+  const double sigma      = center / half_width;
+  double rho              = 1.0 / sigma;
+
+  Q.submit([&](handler &cgh) {
+    auto acc_r = accessor(work.r, cgh, read_only);
+    auto acc_z = accessor(work.z, cgh, write_only);
+    auto acc_d = accessor(work.p_next, cgh, write_only);
+
+    cgh.parallel_for(range<2>(nx, ny), [=](id<2> id) {
+      auto j = id[0] + 1;
+      auto i = id[1] + 1;
+
+      acc_d[j][i] = acc_r[j][i] / center;
+      acc_z[j][i] = acc_d[j][i];
+    });
+  });
+
+  for (int k = 1; k < degree; k++) {
+    const double rho_next = 1.0 / (2.0 * sigma - rho);
+    const double cd       = rho_next * rho;
+    const double cr       = 2.0 * rho_next / half_width;
+    rho                   = rho_next;
+
+    Q.submit([&](handler &cgh) {
+      auto acc_r      = accessor(work.r, cgh, read_only);
+      auto acc_z      = accessor(work.z, cgh, read_only);
+      auto acc_d      = accessor(work.p_next, cgh, read_write);
+      auto acc_z_next = accessor(work.q, cgh, write_only);
+
+      cgh.parallel_for(range<2>(nx, ny), [=](id<2> id) {
+        auto j = id[0] + 1;
+        auto i = id[1] + 1;
+
+        auto Az = A.diag * acc_z[j][i] -
+                  A.cx * (acc_z[j][i + 1] + acc_z[j][i - 1]) -
+                  A.cy * (acc_z[j + 1][i] + acc_z[j - 1][i]);
+        acc_d[j][i]      = cd * acc_d[j][i] + cr * (acc_r[j][i] - Az);
+        acc_z_next[j][i] = acc_z[j][i] + acc_d[j][i];
+      });
+    });
+    std::swap(work.z, work.q);
+  }
+}
+
+// Dot product of r and z over the interior
+static double
+dot_rz(queue &Q, cg_workspace &work, double *d_sum)
+{
+  const int nx = work.r.get_range()[0] - 2;
+  const int ny = work.r.get_range()[1] - 2;
+
+  Q.submit([&](handler &cgh) {
+     auto acc_r = accessor(work.r, cgh, read_only);
+     auto acc_z = accessor(work.z, cgh, read_only);
+
+     auto sum_red = reduction(
+       d_sum,
+       plus<double>(),
+       property::reduction::initialize_to_identity {});
+
+     cgh.parallel_for(range<2>(nx, ny), sum_red, [=](id<2> id, auto &sum) {
+       auto j = id[0] + 1;
+       auto i = id[1] + 1;
+       sum += acc_r[j][i] * acc_z[j][i];
+     });
+   }).wait();
+
+  double sum;
+  Q.copy(d_sum, &sum, 1).wait();
+  return sum;
+}
+
+// Take one step of the theta method
+//   (I - theta a dt L) curr = (I + (1 - theta) a dt L) prev
+// where L is the five-point Laplacian, so theta = 1 gives implicit Euler and
+// theta = 0.5 Crank-Nicolson. Both are stable for any time step.
+// The linear system is solved with preconditioned conjugate gradients
+// without assembling the matrix. The kernels are fused so that an iteration
+// makes two passes over the grid with the Jacobi preconditioner:
+//   1. the new search direction p = z + beta p is formed on the fly while
+//      applying the stencil, q = A p, together with the reduction p.q
+//   2. the updates of the solution and the residual, the preconditioner and
+//      the reductions r.z and r.r
+// The Chebyshev preconditioner adds degree passes and a separate r.z.
+// Since the coefficients are constant, the Jacobi preconditioner is a mere
+// scaling here, whereas the Chebyshev polynomial cuts the iteration count.
+// Arguments:
+//   curr: the new field, which has the same boundary values as prev
+//   work: work space from allocate_cg_workspace
+//   theta: implicitness of the time step
+//   degree: degree of the Chebyshev preconditioner, 0 selects Jacobi
+//   tolerance: reduction of the residual 2-norm at which the solver stops
+//   max_iter: maximum number of iterations
+// Returns:
+//   the number of iterations taken. A message is printed if the solver
+//   stops at max_iter before reaching the tolerance.
+int
+evolve_implicit(
+  queue &Q,
+  buffer<double, 2> &curr,
+  buffer<double, 2> &prev,
+  cg_workspace &work,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  double theta,
+  int degree,
+  double tolerance,
+  int max_iter)
+{
+  const int nx = curr.get_range()[0] - 2;
+  const int ny = curr.get_range()[1] - 2;
+
+  const double c = a * dt;
+  implicit_operator A;
+  A.cx   = theta * c / dx2;
+  A.cy   = theta * c / dy2;
+  A.diag = 1.0 + 2.0 * (A.cx + A.cy);
+  // inverse of the Jacobi preconditioner, or zero when z is computed
+  // separately
+  const double inv_diag = degree > 0 ? 0.0 : 1.0 / A.diag;
+
+  // reduction variables: p.q, r.z and r.r
+  auto d_sums = malloc_device<double>(3, Q);
+  double sums[3];
+
+  // Starting from curr = prev, the initial residual is
+  // b - A prev = a dt L prev, independent of theta
+  Q.submit([&](handler &cgh) {
+     auto acc_prev = accessor(prev, cgh, read_only);
+     auto acc_curr = accessor(curr, cgh, write_only);
+     auto acc_r    = accessor(work.r, cgh, write_only);
+     auto acc_z    = accessor(work.z, cgh, write_only);
+
+     auto rz_red = reduction(
+       d_sums + 1,
+       plus<double>(),
+       property::reduction::initialize_to_identity {});
+     auto rr_red = reduction(
+       d_sums + 2,
+       plus<double>(),
+       property::reduction::initialize_to_identity {});
+
+     cgh.parallel_for(
+       range<2>(nx, ny), rz_red, rr_red, [=](id<2> id, auto &rz, auto &rr) {
+         auto j = id[0] + 1;
+         auto i = id[1] + 1;
+
+         auto r = c * ((acc_prev[j][i + 1] - 2.0 * acc_prev[j][i] +
+                        acc_prev[j][i - 1]) /
+                         dx2 +
+                       (acc_prev[j + 1][i] - 2.0 * acc_prev[j][i] +
+                        acc_prev[j - 1][i]) /
+                         dy2);
+         acc_curr[j][i] = acc_prev[j][i];
+         acc_r[j][i]    = r;
+         acc_z[j][i]    = inv_diag * r;
+         rz += r * inv_diag * r;
+         rr += r * r;
+       });
+   }).wait();
+  Q.copy(d_sums, sums, 3).wait();
+
+  double rz            = sums[1];
+  const double rr_init = sums[2];
+  if (degree > 0) {
+    apply_chebyshev(Q, work, A, degree);
+    rz = dot_rz(Q, work, d_sums + 1);
+  }
+
+  int iter = 0;
+  double beta = 0.0;
+  double rr   = rr_init;
+  while (iter < max_iter && rr > tolerance * tolerance * rr_init) {
+    // new search direction and q = A p
+    Q.submit([&](handler &cgh) {
+       auto acc_z      = accessor(work.z, cgh, read_only);
+       auto acc_p      = accessor(work.p, cgh, read_only);
+       auto acc_p_next = accessor(work.p_next, cgh, write_only);
+       auto acc_q      = accessor(work.q, cgh, write_only);
+
+       auto pq_red = reduction(
+         d_sums,
+         plus<double>(),
+         property::reduction::initialize_to_identity {});
+
+       cgh.parallel_for(range<2>(nx, ny), pq_red, [=](id<2> id, auto &pq) {
+         auto j = id[0] + 1;
+         auto i = id[1] + 1;
+
+         auto p = [&](size_t jj, size_t ii) {
+           return acc_z[jj][ii] + beta * acc_p[jj][ii];
+         };
+         auto pc = p(j, i);
+         auto q  = A.diag * pc - A.cx * (p(j, i + 1) + p(j, i - 1)) -
+                  A.cy * (p(j + 1, i) + p(j - 1, i));
+         acc_p_next[j][i] = pc;
+         acc_q[j][i]      = q;
+         pq += pc * q;
+       });
+     }).wait();
+    std::swap(work.p, work.p_next);
+    Q.copy(d_sums, sums, 1).wait();
+    const double alpha = rz / sums[0];
+
+    // update the solution and the residual, and precondition
+    Q.submit([&](handler &cgh) {
+       auto acc_curr = accessor(curr, cgh, read_write);
+       auto acc_p    = accessor(work.p, cgh, read_only);
+       auto acc_q    = accessor(work.q, cgh, read_only);
+       auto acc_r    = accessor(work.r, cgh, read_write);
+       auto acc_z    = accessor(work.z, cgh, write_only);
+
+       auto rz_red = reduction(
+         d_sums + 1,
+         plus<double>(),
+         property::reduction::initialize_to_identity {});
+       auto rr_red = reduction(
+         d_sums + 2,
+         plus<double>(),
+         property::reduction::initialize_to_identity {});
+
+       cgh.parallel_for(
+         range<2>(nx, ny), rz_red, rr_red, [=](id<2> id, auto &rz, auto &rr) {
+           auto j = id[0] + 1;
+           auto i = id[1] + 1;
+
+           acc_curr[j][i] += alpha * acc_p[j][i];
+           auto r      = acc_r[j][i] - alpha * acc_q[j][i];
+           acc_r[j][i] = r;
+           acc_z[j][i] = inv_diag * r;
+           rz += r * inv_diag * r;
+           rr += r * r;
+         });
+     }).wait();
+    Q.copy(d_sums, sums, 3).wait();
+    iter++;
+
+    double rz_next = sums[1];
+    rr             = sums[2];
+    if (degree > 0) {
+      apply_chebyshev(Q, work, A, degree);
+      rz_next = dot_rz(Q, work, d_sums + 1);
+    }
+    beta = rz_next / rz;
+    rz   = rz_next;
+  }
+
+  free(d_sums, Q);
+
+  if (rr > tolerance * tolerance * rr_init) {
+    printf(
+      "Conjugate gradients not converged after %d iterations, relative "
+      "residual %e (tolerance %e).\n",
+      iter,
+      std::sqrt(rr / rr_init),
+      tolerance);
+  }
+
+  return iter;
+}
@@ -70,26 +70,64 @@ evolve(queue Q, field *curr, field *prev, double a, double dt)
   }
 }
 
-// Update the temperature values using five-point stencil
+// Round the updated value to the storage type T
+template <typename T>
+static inline T
+compress(double value, size_t, size_t, unsigned)
+{
+  return static_cast<T>(value);
+}
+
+// Fixed-point values are rounded stochastically, with a pseudo-random
+// offset hashed from the grid point and the time step. Rounding to nearest
+// would drop every update smaller than half the resolution and freeze the
+// slowly varying regions of the field.
+template <>
+inline fixed16
+compress<fixed16>(double value, size_t j, size_t i, unsigned step)
+{
+  auto h = static_cast<std::uint32_t>(j * 73856093u) ^
+           static_cast<std::uint32_t>(i * 19349663u) ^ (step * 83492791u);
+  h ^= h >> 16;
+  h *= 0x7feb352du;
+  h ^= h >> 15;
+  h *= 0x846ca68bu;
+  h ^= h >> 16;
+  return fixed16::round(value, (h >> 8) * (1.0 / (1 << 24)));
+}
+
+// Update the temperature values using five-point stencil.
+// The values are stored in type T and the update is computed in type Acc,
+// so that single precision storage, which halves the memory traffic of the
+// stencil, can be combined with double precision arithmetic.
 // Arguments:
 //   curr: current temperature values
 //   prev: temperature values from previous time step
 //   a: diffusivity
 //   dt: time step
+//   step: number of the time step, which seeds the stochastic rounding of
+//     fixed-point storage
+template <typename T, typename Acc>
 void
 evolve(
   queue &Q,
-  buffer<double, 2> &curr,
-  buffer<double, 2> &prev,
+  buffer<T, 2> &curr,
+  buffer<T, 2> &prev,
   double a,
   double dt,
   double dx2,
-  double dy2)
+  double dy2,
+  unsigned step)
 {
   // Help the compiler avoid being confused by the structs
   auto nx = curr.get_range()[0] - 2;
   auto ny = curr.get_range()[1] - 2;
 
+  // Coefficients in the precision of the arithmetic
+  const Acc a_dt  = a * dt;
+  const Acc dx2_a = dx2;
+  const Acc dy2_a = dy2;
+
   // Determine the temperature field at next time step
   // As we have fixed boundary conditions, the outermost gridpoints
   // are not updated.
@@ -102,13 +140,415 @@ evolve(
       auto j = id[0] + 1;
       auto i = id[1] + 1;
 
-      acc_curr[j][i] =
-        acc_prev[j][i] +
-        a * dt *
-          ((acc_prev[j][i + 1] - 2.0 * acc_prev[j][i] + acc_prev[j][i - 1]) /
-             dx2 +
-           (acc_prev[j + 1][i] - 2.0 * acc_prev[j][i] + acc_prev[j - 1][i]) /
-             dy2);
+      auto u = [&](size_t jj, size_t ii) {
+        return static_cast<Acc>(acc_prev[jj][ii]);
+      };
+
+      acc_curr[j][i] = compress<T>(
+        u(j, i) +
+          a_dt * ((u(j, i + 1) - Acc(2) * u(j, i) + u(j, i - 1)) / dx2_a +
+                  (u(j + 1, i) - Acc(2) * u(j, i) + u(j - 1, i)) / dy2_a),
+        j,
+        i,
+        step);
+    });
+  });
+}
+
+template void
+evolve<float, float>(
+  queue &Q,
+  buffer<float, 2> &curr,
+  buffer<float, 2> &prev,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  unsigned step);
+template void
+evolve<float, double>(
+  queue &Q,
+  buffer<float, 2> &curr,
+  buffer<float, 2> &prev,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  unsigned step);
+template void
+evolve<fixed16, double>(
+  queue &Q,
+  buffer<fixed16, 2> &curr,
+  buffer<fixed16, 2> &prev,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  unsigned step);
+template void
+evolve<double, double>(
+  queue &Q,
+  buffer<double, 2> &curr,
+  buffer<double, 2> &prev,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  unsigned step);
+
+// Advance the temperature values by several time steps in one kernel launch
+// (temporal blocking).
+// Each work-group loads its tile of prev, extended by a halo of depth
+// nsteps, into local memory once, and then applies the five-point stencil
+// nsteps times entirely in local memory. At every step the valid region
+// shrinks by one cell on each side, so that after nsteps steps only the tile
+// itself is left and is written out to curr. Global memory is thus read and
+// written once every nsteps steps, at the price of some redundant work in
+// the halos.
+// Arguments:
+//   curr: temperature values after nsteps time steps
+//   prev: temperature values at the start of the block of time steps
+//   a: diffusivity
+//   dt: time step
+//   nsteps: number of time steps to take per kernel launch
+//   tile: work-group size, i.e. the shape of the tile owned by a work-group
+void
+evolve_blocked(
+  queue &Q,
+  buffer<double, 2> &curr,
+  buffer<double, 2> &prev,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  int nsteps,
+  range<2> tile)
+{
+  const int nx = curr.get_range()[0] - 2;
+  const int ny = curr.get_range()[1] - 2;
+
+  const int k  = nsteps;
+  const int ty = tile[0];
+  const int tx = tile[1];
+  // extent of the tile including the halo
+  const int hy = ty + 2 * k;
+  const int hx = tx + 2 * k;
+
+  // the global range spans the interior, rounded up to a multiple of the
+  // tile size. Work-items falling outside of the interior still take part in
+  // loading and updating the halo.
+  range global { static_cast<size_t>((nx + ty - 1) / ty * ty),
+                 static_cast<size_t>((ny + tx - 1) / tx * tx) };
+
+  Q.submit([&](handler &cgh) {
+    auto acc_curr = accessor(curr, cgh, write_only);
+    auto acc_prev = accessor(prev, cgh, read_only);
+
+    // two tiles in local memory, used in ping-pong fashion
+    auto tile_a = local_accessor<double, 2>(range<2>(hy, hx), cgh);
+    auto tile_b = local_accessor<double, 2>(range<2>(hy, hx), cgh);
+
+    cgh.parallel_for(nd_range { global, tile }, [=](nd_item<2> it) {
+      // global indices of the upper left corner of the tile with its halo.
+      // These can fall outside of the grid for tiles next to the boundary.
+      const int j0 = it.get_group(0) * ty + 1 - k;
+      const int i0 = it.get_group(1) * tx + 1 - k;
+
+      const int lj = it.get_local_id(0);
+      const int li = it.get_local_id(1);
+
+      // load the tile with its halo, skipping points outside of the grid
+      for (int jj = lj; jj < hy; jj += ty) {
+        for (int ii = li; ii < hx; ii += tx) {
+          const int j = j0 + jj;
+          const int i = i0 + ii;
+          if (j >= 0 && j <= nx + 1 && i >= 0 && i <= ny + 1) {
+            tile_a[jj][ii] = acc_prev[j][i];
+          }
+        }
+      }
+      it.barrier(access::fence_space::local_space);
+
+      for (int s = 1; s <= k; ++s) {
+        const auto &src = (s % 2 == 1) ? tile_a : tile_b;
+        const auto &dst = (s % 2 == 1) ? tile_b : tile_a;
+
+        // after s steps, only points at distance s or more from the edge of
+        // the halo are still valid
+        for (int jj = s + lj; jj < hy - s; jj += ty) {
+          for (int ii = s + li; ii < hx - s; ii += tx) {
+            const int j = j0 + jj;
+            const int i = i0 + ii;
+            if (j < 0 || j > nx + 1 || i < 0 || i > ny + 1) {
+              continue;
+            }
+            if (j == 0 || j == nx + 1 || i == 0 || i == ny + 1) {
+              // fixed boundary conditions: carry the value over
+              dst[jj][ii] = src[jj][ii];
+            } else {
+              dst[jj][ii] =
+                src[jj][ii] +
+                a * dt *
+                  ((src[jj][ii + 1] - 2.0 * src[jj][ii] + src[jj][ii - 1]) /
+                     dx2 +
+                   (src[jj + 1][ii] - 2.0 * src[jj][ii] + src[jj - 1][ii]) /
+                     dy2);
+            }
+          }
+        }
+        it.barrier(access::fence_space::local_space);
+      }
+
+      // write the tile, without halo, to global memory
+      const auto &res = (k % 2 == 1) ? tile_b : tile_a;
+      const int j     = it.get_global_id(0) + 1;
+      const int i     = it.get_global_id(1) + 1;
+      if (j <= nx && i <= ny) {
+        acc_curr[j][i] = res[lj + k][li + k];
+      }
+    });
+  });
+}
+
+// Update the temperature values using five-point stencil, staging the
+// previous values in local memory.
+// Each work-group loads its tile of prev, together with a one-cell halo,
+// into local memory once and then computes the stencil from there, rather
+// than having every work-item read its five neighbours from global memory.
+// Arguments:
+//   curr: current temperature values
+//   prev: temperature values from previous time step
+//   a: diffusivity
+//   dt: time step
+//   tile: work-group size, i.e. the shape of the tile owned by a work-group
+void
+evolve_tiled(
+  queue &Q,
+  buffer<double, 2> &curr,
+  buffer<double, 2> &prev,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  range<2> tile)
+{
+  const int nx = curr.get_range()[0] - 2;
+  const int ny = curr.get_range()[1] - 2;
+
+  const int ty = tile[0];
+  const int tx = tile[1];
+
+  // the global range spans the interior, rounded up to a multiple of the
+  // tile size
+  range global { static_cast<size_t>((nx + ty - 1) / ty * ty),
+                 static_cast<size_t>((ny + tx - 1) / tx * tx) };
+
+  Q.submit([&](handler &cgh) {
+    auto acc_curr = accessor(curr, cgh, write_only);
+    auto acc_prev = accessor(prev, cgh, read_only);
+
+    // tile of prev, including the halo, in local memory
+    auto tile_prev = local_accessor<double, 2>(range<2>(ty + 2, tx + 2), cgh);
+
+    cgh.parallel_for(nd_range { global, tile }, [=](nd_item<2> it) {
+      // global indices of the upper left corner of the tile with its halo
+      const int j0 = it.get_group(0) * ty;
+      const int i0 = it.get_group(1) * tx;
+
+      const int lj = it.get_local_id(0);
+      const int li = it.get_local_id(1);
+
+      // load the tile with its halo: the work-group is smaller than the
+      // haloed tile, so some work-items load more than one value
+      for (int jj = lj; jj < ty + 2; jj += ty) {
+        for (int ii = li; ii < tx + 2; ii += tx) {
+          if (j0 + jj <= nx + 1 && i0 + ii <= ny + 1) {
+            tile_prev[jj][ii] = acc_prev[j0 + jj][i0 + ii];
+          }
+        }
+      }
+      // synchronize to ensure all work-items have a consistent view of the
+      // local memory holding the tile
+      it.barrier(access::fence_space::local_space);
+
+      const int j = j0 + lj + 1;
+      const int i = i0 + li + 1;
+      if (j <= nx && i <= ny) {
+        const int tj = lj + 1;
+        const int ti = li + 1;
+
+        acc_curr[j][i] =
+          tile_prev[tj][ti] +
+          a * dt *
+            ((tile_prev[tj][ti + 1] - 2.0 * tile_prev[tj][ti] +
+              tile_prev[tj][ti - 1]) /
+               dx2 +
+             (tile_prev[tj + 1][ti] - 2.0 * tile_prev[tj][ti] +
+              tile_prev[tj - 1][ti]) /
+               dy2);
+      }
+    });
+  });
+}
+
+// Update the temperature values using five-point stencil and measure how
+// much the field changed in the process.
+// The maximum norm of curr - prev is computed with a reduction fused into
+// the stencil kernel, so checking for convergence costs no extra pass over
+// the grid.
+// Arguments:
+//   curr: current temperature values
+//   prev: temperature values from previous time step
+//   a: diffusivity
+//   dt: time step
+// Returns:
+//   the largest absolute change of the temperature over the grid
+double
+evolve_residual(
+  queue &Q,
+  buffer<double, 2> &curr,
+  buffer<double, 2> &prev,
+  double a,
+  double dt,
+  double dx2,
+  double dy2)
+{
+  auto nx = curr.get_range()[0] - 2;
+  auto ny = curr.get_range()[1] - 2;
+
+  double residual = 0.0;
+
+  // the reduction variable lives in device memory
+  auto d_residual = malloc_device<double>(1, Q);
+  Q.copy(&residual, d_residual, 1).wait();
+
+  Q.submit([&](handler &cgh) {
+     auto acc_curr = accessor(curr, cgh, read_write);
+     auto acc_prev = accessor(prev, cgh, read_only);
+
+     auto max_red = reduction(d_residual, maximum<double>());
+
+     cgh.parallel_for(range<2>(nx, ny), max_red, [=](id<2> id, auto &max) {
+       auto j = id[0] + 1;
+       auto i = id[1] + 1;
+
+       auto value =
+         acc_prev[j][i] +
+         a * dt *
+           ((acc_prev[j][i + 1] - 2.0 * acc_prev[j][i] + acc_prev[j][i - 1]) /
+              dx2 +
+            (acc_prev[j + 1][i] - 2.0 * acc_prev[j][i] + acc_prev[j - 1][i]) /
+              dy2);
+
+       acc_curr[j][i] = value;
+       max.combine(sycl::fabs(value - acc_prev[j][i]));
+     });
+   }).wait();
+
+  Q.copy(d_residual, &residual, 1).wait();
+
+  free(d_residual, Q);
+
+  return residual;
+}
+
+// Apply the five-point Laplacian to the field u at point (j, i)
+// Arguments:
+//   u: accessor to the field values
+//   j, i: indices of the point
+//   dx2, dy2: squared grid spacings
+template <typename Accessor>
+static inline double
+laplacian(const Accessor &u, size_t j, size_t i, double dx2, double dy2)
+{
+  return (u[j][i + 1] - 2.0 * u[j][i] + u[j][i - 1]) / dx2 +
+         (u[j + 1][i] - 2.0 * u[j][i] + u[j - 1][i]) / dy2;
+}
+
+// Advance the temperature values by one super-step of the second-order
+// Runge-Kutta-Legendre (RKL2) super-time-stepping scheme, see Meyer, Balsara
+// and Aslam, J. Comput. Phys. 257 (2014) 594-626.
+// A super-step with s stages launches s stencil kernels and is stable for
+// time steps up to (s^2 + s - 2) / 4 times the explicit limit.
+// Arguments:
+//   curr: temperature values after the super-step
+//   prev: temperature values before the super-step
+//   work: scratch buffer with the same dimensions and boundary values
+//   a: diffusivity
+//   dt: super-step
+//   nstages: number of stages s, at least 2
+void
+evolve_rkl2(
+  queue &Q,
+  buffer<double, 2> &curr,
+  buffer<double, 2> &prev,
+  buffer<double, 2> &work,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  int nstages)
+{
+  auto nx = curr.get_range()[0] - 2;
+  auto ny = curr.get_range()[1] - 2;
+
+  const int s       = nstages;
+  const double w1 = 4.0 / (s * s + s - 2);
+  // coefficients b_j of the scheme
+  auto b = [](int j) {
+    return j < 2 ? 1.0 / 3.0 : (j * j + j - 2.0) / (2.0 * j * (j + 1.0));
+  };
+
+  // The stages are written alternately to the two output buffers, such that
+  // the last stage ends up in curr. A stage only reads the stage two steps
+  // before at the point it is writing, so it can overwrite it.
+  auto &odd  = (s % 2 == 1) ? curr : work;
+  auto &even = (s % 2 == 1) ? work : curr;
+
+  // first stage
+  const double mu1 = b(1) * w1;
+  Q.submit([&](handler &cgh) {
+    auto acc_y0 = accessor(prev, cgh, read_only);
+    auto acc_y1 = accessor(odd, cgh, write_only);
+
+    cgh.parallel_for(range<2>(nx, ny), [=](id<2> id) {
+      auto j = id[0] + 1;
+      auto i = id[1] + 1;
+
+      acc_y1[j][i] =
+        acc_y0[j][i] + mu1 * dt * a * laplacian(acc_y0, j, i, dx2, dy2);
     });
   });
+
+  // remaining stages
+  for (int k = 2; k <= s; k++) {
+    const double mu    = (2.0 * k - 1.0) / k * b(k) / b(k - 1);
+    const double nu    = -(k - 1.0) / k * b(k) / b(k - 2);
+    const double mu_t  = mu * w1;
+    const double gamma = -(1.0 - b(k - 1)) * mu_t;
+    // the stage two steps before the first stage is the initial state
+    const bool second = (k == 2);
+
+    auto &yk   = (k % 2 == 1) ? odd : even;
+    auto &ykm1 = (k % 2 == 1) ? even : odd;
+
+    Q.submit([&](handler &cgh) {
+      auto acc_y0   = accessor(prev, cgh, read_only);
+      auto acc_ykm1 = accessor(ykm1, cgh, read_only);
+      auto acc_yk   = accessor(yk, cgh, read_write);
+
+      cgh.parallel_for(range<2>(nx, ny), [=](id<2> id) {
+        auto j = id[0] + 1;
+        auto i = id[1] + 1;
+
+        auto y0   = acc_y0[j][i];
+        auto ykm2 = second ? y0 : acc_yk[j][i];
+
+        acc_yk[j][i] = mu * acc_ykm1[j][i] + nu * ykm2 + (1.0 - mu - nu) * y0 +
+                       dt * a *
+                         (mu_t * laplacian(acc_ykm1, j, i, dx2, dy2) +
+                          gamma * laplacian(acc_y0, j, i, dx2, dy2));
+      });
+    });
+  }
 }
@@ -21,12 +21,16 @@
 
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <vector>
 
 #include <sycl/sycl.hpp>
 
-// Datatype for temperature field
-struct field
+// Datatype for temperature field, with the temperature values stored in
+// type T
+template <typename T>
+struct basic_field
 {
   // nx and ny are the dimensions of the field. The array data
   // contains also ghost layers, so it will have dimensions nx+2 x ny+2
@@ -36,7 +40,63 @@ struct field
   double dx;
   double dy;
   // The temperature values in the 2D grid
-  std::vector<double> data;
+  std::vector<T> data;
+};
+
+// The solver works in double precision unless asked otherwise
+using field = basic_field<double>;
+
+// Temperature stored in 16 bits as a fixed-point number spanning the 0-100
+// degree range that the colormap of the png writer assumes, with a
+// resolution of about 0.0015 degrees. Values outside the range are clamped.
+// It converts to and from double, so the stencil decompresses the values
+// on load and compresses the result on store.
+struct fixed16
+{
+  std::uint16_t bits;
+
+  static constexpr double scale = 65535.0 / 100.0;
+
+  fixed16() = default;
+
+  // Round to the nearest fixed-point value
+  fixed16(double value) : fixed16(round(value, 0.5)) {}
+
+  operator double() const { return bits * (1.0 / scale); }
+
+  // Round down after adding offset, in [0, 1), in units of the resolution.
+  // A uniformly distributed offset rounds stochastically: up or down with
+  // probabilities given by the distance to the two neighbouring values, so
+  // that updates smaller than half the resolution are not lost on average.
+  static fixed16
+  round(double value, double offset)
+  {
+    fixed16 result;
+    result.bits = static_cast<std::uint16_t>(
+      std::clamp(value, 0.0, 100.0) * scale + offset);
+    return result;
+  }
+};
+
+// Summary of the temperature values over the non-boundary grid cells
+struct field_statistics
+{
+  double sum;
+  double min;
+  double max;
+};
+
+// Work space of the conjugate gradient solver for implicit time steps. The
+// fields have the same extent as the temperature, ghost layers included.
+struct cg_workspace
+{
+  // residual, preconditioned residual, search direction, next search
+  // direction and the operator applied to the search direction
+  sycl::buffer<double, 2> r;
+  sycl::buffer<double, 2> z;
+  sycl::buffer<double, 2> p;
+  sycl::buffer<double, 2> p_next;
+  sycl::buffer<double, 2> q;
 };
 
 // We use here fixed grid spacing
@@ -44,30 +104,83 @@ constexpr auto DX = 0.01;
 constexpr auto DY = 0.01;
 
 // Function prototypes
+template <typename T>
 void
-set_field_dimensions(field *temperature, int nx, int ny);
+set_field_dimensions(basic_field<T> *temperature, int nx, int ny);
 
+template <typename T>
 void
 initialize(
   int argc,
   char *argv[],
-  field *temperature1,
-  field *temperature2,
+  basic_field<T> *temperature1,
+  basic_field<T> *temperature2,
   int *nsteps);
 
+template <typename T>
 void
-generate_field(field *temperature);
+generate_field(basic_field<T> *temperature);
+
+int
+parameter_from_env(const char *name, int fallback);
+
+double
+parameter_from_env(const char *name, double fallback);
 
+template <typename T>
 double
-average(field *temperature);
+average(basic_field<T> *temperature);
+
+template <typename T>
+field_statistics
+statistics(sycl::queue &Q, sycl::buffer<T, 2> &temperature);
+
+template <typename T>
+double
+average(sycl::queue &Q, sycl::buffer<T, 2> &temperature);
 
 void
 evolve(sycl::queue &Q, field *curr, field *prev, double a, double dt);
 
+template <typename T, typename Acc = T>
 void
 evolve(
   sycl::queue &Q,
-  sycl::buffer<double, 2> &current,
+  sycl::buffer<T, 2> &current,
+  sycl::buffer<T, 2> &prev,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  unsigned step = 0);
+
+void
+evolve_blocked(
+  sycl::queue &Q,
+  sycl::buffer<double, 2> &curr,
+  sycl::buffer<double, 2> &prev,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  int nsteps,
+  sycl::range<2> tile);
+
+void
+evolve_tiled(
+  sycl::queue &Q,
+  sycl::buffer<double, 2> &curr,
+  sycl::buffer<double, 2> &prev,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  sycl::range<2> tile);
+
+double
+evolve_residual(
+  sycl::queue &Q,
+  sycl::buffer<double, 2> &curr,
   sycl::buffer<double, 2> &prev,
   double a,
   double dt,
@@ -75,21 +188,94 @@ evolve(
   double dy2);
 
 void
-write_field(field *temperature, int iter);
+evolve_rkl2(
+  sycl::queue &Q,
+  sycl::buffer<double, 2> &curr,
+  sycl::buffer<double, 2> &prev,
+  sycl::buffer<double, 2> &work,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  int nstages);
+
+void
+solve_tridiagonal(
+  sycl::queue &Q,
+  sycl::buffer<double, 2> &d,
+  sycl::buffer<double, 2> &scratch,
+  int axis,
+  double lower,
+  double diag,
+  double upper,
+  int npcr);
+
+void
+evolve_adi(
+  sycl::queue &Q,
+  sycl::buffer<double, 2> &curr,
+  sycl::buffer<double, 2> &prev,
+  sycl::buffer<double, 2> &work,
+  sycl::buffer<double, 2> &rhs,
+  sycl::buffer<double, 2> &scratch,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  int npcr);
+
+cg_workspace
+allocate_cg_workspace(sycl::queue &Q, sycl::range<2> extent);
+
+int
+evolve_implicit(
+  sycl::queue &Q,
+  sycl::buffer<double, 2> &curr,
+  sycl::buffer<double, 2> &prev,
+  cg_workspace &work,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  double theta,
+  int degree,
+  double tolerance,
+  int max_iter);
+
+int
+solve_multigrid(
+  sycl::queue &Q,
+  sycl::buffer<double, 2> &temperature,
+  double dx2,
+  double dy2,
+  int cycle,
+  double tolerance,
+  int max_cycles,
+  double *residual);
+
+template <typename T>
+void
+write_field(basic_field<T> *temperature, int iter);
 
+template <typename T>
 void
-read_field(field *temperature1, field *temperature2, char *filename);
+read_field(
+  basic_field<T> *temperature1,
+  basic_field<T> *temperature2,
+  char *filename);
 
+template <typename T>
 void
-copy_field(field *temperature1, field *temperature2);
+copy_field(basic_field<T> *temperature1, basic_field<T> *temperature2);
 
+template <typename T>
 void
-swap_fields(field *temperature1, field *temperature2);
+swap_fields(basic_field<T> *temperature1, basic_field<T> *temperature2);
 
+template <typename T>
 void
-swap_fields(
-  sycl::buffer<double, 2> &temperature1,
-  sycl::buffer<double, 2> &temperature2);
+swap_fields(sycl::buffer<T, 2> &temperature1, sycl::buffer<T, 2> &temperature2);
 
+template <typename T>
 void
-allocate_field(field *temperature);
+allocate_field(basic_field<T> *temperature);
@@ -30,9 +30,11 @@
 #include "pngwriter.h"
 
 // Output routine that prints out a picture of the temperature
-// distribution.
+// distribution. The picture is drawn from the values converted to double
+// whatever the storage type.
+template <typename T>
 void
-write_field(field *temperature, int iter)
+write_field(basic_field<T> *temperature, int iter)
 {
   char filename[64];
 
@@ -53,11 +55,23 @@ write_field(field *temperature, int iter)
   save_png(inner_data.data(), temperature->nx, temperature->ny, filename);
 }
 
+template void
+write_field(basic_field<float> *temperature, int iter);
+template void
+write_field(basic_field<double> *temperature, int iter);
+template void
+write_field(basic_field<fixed16> *temperature, int iter);
+
 // Read the initial temperature distribution from a file and
 // initialize the temperature fields temperature1 and
-// temperature2 to the same initial state.
+// temperature2 to the same initial state. The values are read in double
+// precision and rounded to the storage type.
+template <typename T>
 void
-read_field(field *temperature1, field *temperature2, char *filename)
+read_field(
+  basic_field<T> *temperature1,
+  basic_field<T> *temperature2,
+  char *filename)
 {
   FILE *fp;
   int nx, ny, ind;
@@ -122,3 +136,19 @@ read_field(field *temperature1, field *temperature2, char *filename)
 
   fclose(fp);
 }
+
+template void
+read_field(
+  basic_field<float> *temperature1,
+  basic_field<float> *temperature2,
+  char *filename);
+template void
+read_field(
+  basic_field<double> *temperature1,
+  basic_field<double> *temperature2,
+  char *filename);
+template void
+read_field(
+  basic_field<fixed16> *temperature1,
+  basic_field<fixed16> *temperature2,
+  char *filename);
@@ -0,0 +1,356 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Geometric multigrid solver for the steady state of the heat equation
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+
+#include "heat.h"
+
+using namespace sycl;
+
+// One level of the multigrid hierarchy. All fields include a ghost layer,
+// which holds the boundary values on the finest level and zeros on the
+// coarser ones.
+struct mg_level
+{
+  int nx;
+  int ny;
+  // squared grid spacings
+  double dx2;
+  double dy2;
+  // solution, right-hand side and residual
+  buffer<double, 2> u;
+  buffer<double, 2> f;
+  buffer<double, 2> r;
+};
+
+// Set all values of a buffer, ghost layers included, to zero
+static void
+fill_zero(queue &Q, buffer<double, 2> &data)
+{
+  Q.submit([&](handler &cgh) {
+    auto acc = accessor(data, cgh, write_only, no_init);
+    cgh.parallel_for(data.get_range(), [=](id<2> id) {
+      acc[id] = 0.0;
+    });
+  });
+}
+
+// One red-black Gauss-Seidel sweep on the equation -Laplacian(u) = f.
+// The points of one color only depend on points of the other color, so each
+// half sweep updates all points of one color in parallel.
+static void
+smooth(queue &Q, mg_level &level)
+{
+  const auto dx2 = level.dx2;
+  const auto dy2 = level.dy2;
+  // inverse of the diagonal of the five-point operator
+  const auto inv_diag = 1.0 / (2.0 / dx2 + 2.0 / dy2);
+
+  for (int color = 0; color < 2; color++) {
+    Q.submit([&](handler &cgh) {
+      auto acc_u = accessor(level.u, cgh, read_write);
+      auto acc_f = accessor(level.f, cgh, read_only);
+
+      cgh.parallel_for(range<2>(level.nx, level.ny), [=](id<2> id) {
+        auto j = id[0] + 1;
+        auto i = id[1] + 1;
+        if (static_cast<int>((j + i) % 2) != color) {
+          return;
+        }
+
+        acc_u[j][i] = (acc_f[j][i] + (acc_u[j][i + 1] + acc_u[j][i - 1]) / dx2 +
+                       (acc_u[j + 1][i] + acc_u[j - 1][i]) / dy2) *
+                      inv_diag;
+      });
+    });
+  }
+}
+
+// Compute the residual r = f + Laplacian(u) in the interior
+static void
+compute_residual(queue &Q, mg_level &level)
+{
+  const auto dx2 = level.dx2;
+  const auto dy2 = level.dy2;
+
+  Q.submit([&](handler &cgh) {
+    auto acc_u = accessor(level.u, cgh, read_only);
+    auto acc_f = accessor(level.f, cgh, read_only);
+    auto acc_r = accessor(level.r, cgh, write_only);
+
+    cgh.parallel_for(range<2>(level.nx, level.ny), [=](id<2> id) {
+      auto j = id[0] + 1;
+      auto i = id[1] + 1;
+
+      acc_r[j][i] =
+        acc_f[j][i] +
+        (acc_u[j][i + 1] - 2.0 * acc_u[j][i] + acc_u[j][i - 1]) / dx2 +
+        (acc_u[j + 1][i] - 2.0 * acc_u[j][i] + acc_u[j - 1][i]) / dy2;
+    });
+  });
+}
+
+// Largest absolute value of the residual over the interior
+static double
+residual_norm(queue &Q, mg_level &level)
+{
+  double norm = 0.0;
+
+  // the reduction variable lives in device memory
+  auto d_norm = malloc_device<double>(1, Q);
+  Q.copy(&norm, d_norm, 1).wait();
+
+  Q.submit([&](handler &cgh) {
+     auto acc_r = accessor(level.r, cgh, read_only);
+
+     auto max_red = reduction(d_norm, maximum<double>());
+
+     cgh.parallel_for(
+       range<2>(level.nx, level.ny), max_red, [=](id<2> id, auto &max) {
+         max.combine(sycl::fabs(acc_r[id[0] + 1][id[1] + 1]));
+       });
+   }).wait();
+
+  Q.copy(d_norm, &norm, 1).wait();
+
+  free(d_norm, Q);
+
+  return norm;
+}
+
+// The grid points of a level sit at j * h for j = 0 ... n + 1, the boundary
+// values at j = 0 and n + 1 included. The coarse level has n / 2 interior
+// points spread evenly over the same interval, so that the grids are nested
+// for odd n, and the transfers interpolate linearly between the positions of
+// the points in either case.
+
+// Ratio of the coarse to the fine grid spacing along one dimension
+static inline double
+coarsening_ratio(int nfine, int ncoarse)
+{
+  return static_cast<double>(nfine + 1) / (ncoarse + 1);
+}
+
+// Weight of fine point j in the linear interpolation from coarse point jc
+static inline double
+transfer_weight(int j, int jc, double ratio)
+{
+  return sycl::fmax(0.0, 1.0 - sycl::fabs(j / ratio - jc));
+}
+
+// Restrict the residual of the fine level to the right-hand side of the
+// coarse level with the transpose of the interpolation, scaled by the ratio
+// of the cell areas, and reset the coarse solution to zero.
+// For odd fine dimensions this is the usual full weighting.
+static void
+restrict_residual(queue &Q, mg_level &fine, mg_level &coarse)
+{
+  const int nx  = fine.nx;
+  const int ny  = fine.ny;
+  const auto sy = coarsening_ratio(fine.nx, coarse.nx);
+  const auto sx = coarsening_ratio(fine.ny, coarse.ny);
+
+  Q.submit([&](handler &cgh) {
+    auto acc_r = accessor(fine.r, cgh, read_only);
+    auto acc_f = accessor(coarse.f, cgh, write_only);
+    auto acc_u = accessor(coarse.u, cgh, write_only);
+
+    cgh.parallel_for(range<2>(coarse.nx, coarse.ny), [=](id<2> id) {
+      const int jc = id[0] + 1;
+      const int ic = id[1] + 1;
+
+      // fine points within one coarse grid spacing
+      const int jmin = std::max(1, static_cast<int>((jc - 1) * sy) + 1);
+      const int jmax = std::min(nx, static_cast<int>((jc + 1) * sy));
+      const int imin = std::max(1, static_cast<int>((ic - 1) * sx) + 1);
+      const int imax = std::min(ny, static_cast<int>((ic + 1) * sx));
+
+      double sum = 0.0;
+      for (int j = jmin; j <= jmax; j++) {
+        const auto wj = transfer_weight(j, jc, sy);
+        for (int i = imin; i <= imax; i++) {
+          sum += wj * transfer_weight(i, ic, sx) * acc_r[j][i];
+        }
+      }
+      acc_f[jc][ic] = sum / (sy * sx);
+      acc_u[jc][ic] = 0.0;
+    });
+  });
+}
+
+// Interpolate the coarse correction bilinearly and add it to the fine
+// solution
+static void
+prolongate_correction(queue &Q, mg_level &coarse, mg_level &fine)
+{
+  const auto sy = coarsening_ratio(fine.nx, coarse.nx);
+  const auto sx = coarsening_ratio(fine.ny, coarse.ny);
+
+  Q.submit([&](handler &cgh) {
+    auto acc_e = accessor(coarse.u, cgh, read_only);
+    auto acc_u = accessor(fine.u, cgh, read_write);
+
+    cgh.parallel_for(range<2>(fine.nx, fine.ny), [=](id<2> id) {
+      const int j = id[0] + 1;
+      const int i = id[1] + 1;
+
+      // position of the fine point on the coarse grid
+      const auto y  = j / sy;
+      const auto x  = i / sx;
+      const int jc  = static_cast<int>(y);
+      const int ic  = static_cast<int>(x);
+      const auto wy = y - jc;
+      const auto wx = x - ic;
+
+      acc_u[j][i] += (1.0 - wy) * ((1.0 - wx) * acc_e[jc][ic] +
+                                   wx * acc_e[jc][ic + 1]) +
+                     wy * ((1.0 - wx) * acc_e[jc + 1][ic] +
+                           wx * acc_e[jc + 1][ic + 1]);
+    });
+  });
+}
+
+// Multigrid cycle on level l of the hierarchy: cycle = 1 gives a V-cycle,
+// cycle = 2 a W-cycle
+static void
+mg_cycle(queue &Q, std::vector<mg_level> &levels, size_t l, int cycle)
+{
+  // number of pre- and post-smoothing sweeps
+  constexpr auto nsmooth = 2;
+
+  auto &level = levels[l];
+
+  if (l + 1 == levels.size()) {
+    // the coarsest level has at most 2 x 2 points and is solved by
+    // smoothing alone
+    for (int sweep = 0; sweep < 2 * (level.nx + level.ny); sweep++) {
+      smooth(Q, level);
+    }
+    return;
+  }
+
+  for (int sweep = 0; sweep < nsmooth; sweep++) {
+    smooth(Q, level);
+  }
+
+  compute_residual(Q, level);
+  restrict_residual(Q, level, levels[l + 1]);
+
+  for (int c = 0; c < cycle; c++) {
+    mg_cycle(Q, levels, l + 1, cycle);
+  }
+
+  prolongate_correction(Q, levels[l + 1], level);
+
+  for (int sweep = 0; sweep < nsmooth; sweep++) {
+    smooth(Q, level);
+  }
+}
+
+// Solve for the steady state of the heat equation, i.e. the Laplace equation
+// with the boundary values in the ghost layers of temperature, with
+// geometric multigrid.
+// The grid is coarsened by a factor of about two in each dimension until it
+// has at most two points along it. Each cycle costs a fixed number of passes
+// over every level, so that the work per cycle is proportional to the number
+// of grid points, and the number of cycles needed does not grow with the size
+// of the grid.
+// Arguments:
+//   temperature: initial guess on entry, steady state on exit
+//   cycle: 1 for V-cycles, 2 for W-cycles
+//   tolerance: stop when the maximum norm of the residual has decreased by
+//     this factor
+//   max_cycles: maximum number of cycles
+//   residual: relative residual at exit
+// Returns:
+//   the number of cycles taken
+int
+solve_multigrid(
+  queue &Q,
+  buffer<double, 2> &temperature,
+  double dx2,
+  double dy2,
+  int cycle,
+  double tolerance,
+  int max_cycles,
+  double *residual)
+{
+  std::vector<mg_level> levels;
+
+  // the finest level works on the temperature itself
+  int nx = temperature.get_range()[0] - 2;
+  int ny = temperature.get_range()[1] - 2;
+  range<2> extent { static_cast<size_t>(nx + 2), static_cast<size_t>(ny + 2) };
+  levels.push_back(
+    { nx, ny, dx2, dy2, temperature, buffer<double, 2>(extent),
+      buffer<double, 2>(extent) });
+  // Laplace equation: zero right-hand side
+  fill_zero(Q, levels.back().f);
+
+  // A dimension that has reached two points is left as it is while the
+  // other one keeps being coarsened, so that the coarsest level has at most
+  // two points along both dimensions also for elongated grids
+  while (nx > 2 || ny > 2) {
+    const int nx_coarse = nx > 2 ? nx / 2 : nx;
+    const int ny_coarse = ny > 2 ? ny / 2 : ny;
+    // the first dimension is the y-direction of the stencil
+    dy2 *= std::pow(coarsening_ratio(nx, nx_coarse), 2);
+    dx2 *= std::pow(coarsening_ratio(ny, ny_coarse), 2);
+    nx = nx_coarse;
+    ny = ny_coarse;
+    extent = range<2> { static_cast<size_t>(nx + 2),
+                        static_cast<size_t>(ny + 2) };
+    levels.push_back(
+      { nx, ny, dx2, dy2, buffer<double, 2>(extent), buffer<double, 2>(extent),
+        buffer<double, 2>(extent) });
+    // zero ghost layers, i.e. homogeneous boundary conditions, for the
+    // corrections
+    fill_zero(Q, levels.back().u);
+    fill_zero(Q, levels.back().f);
+    fill_zero(Q, levels.back().r);
+  }
+  fill_zero(Q, levels.front().r);
+
+  compute_residual(Q, levels.front());
+  const double initial_norm = residual_norm(Q, levels.front());
+  *residual                 = 1.0;
+  if (initial_norm == 0.0) {
+    *residual = 0.0;
+    return 0;
+  }
+
+  int ncycles = 0;
+  while (ncycles < max_cycles && *residual > tolerance) {
+    mg_cycle(Q, levels, 0, cycle);
+    ncycles++;
+
+    compute_residual(Q, levels.front());
+    *residual = residual_norm(Q, levels.front()) / initial_norm;
+  }
+
+  return ncycles;
+}
@@ -31,9 +31,16 @@
 // Default number of iteration steps
 constexpr auto NSTEPS = 500;
 
-/* Initialize the heat equation solver */
+/* Initialize the heat equation solver, with the temperature stored in
+ * type T */
+template <typename T>
 void
-initialize(int argc, char *argv[], field *current, field *previous, int *nsteps)
+initialize(
+  int argc,
+  char *argv[],
+  basic_field<T> *current,
+  basic_field<T> *previous,
+  int *nsteps)
 {
   /*
    * Following combinations of command line arguments are possible:
@@ -92,11 +99,34 @@ initialize(int argc, char *argv[], field *current, field *previous, int *nsteps)
   }
 }
 
+template void
+initialize(
+  int argc,
+  char *argv[],
+  basic_field<float> *current,
+  basic_field<float> *previous,
+  int *nsteps);
+template void
+initialize(
+  int argc,
+  char *argv[],
+  basic_field<double> *current,
+  basic_field<double> *previous,
+  int *nsteps);
+template void
+initialize(
+  int argc,
+  char *argv[],
+  basic_field<fixed16> *current,
+  basic_field<fixed16> *previous,
+  int *nsteps);
+
 /* Generate initial temperature field.  Pattern is disc with a radius
  * of nx / 6 in the center of the grid.
  * Boundary conditions are (different) constant temperatures outside the grid */
+template <typename T>
 void
-generate_field(field *temperature)
+generate_field(basic_field<T> *temperature)
 {
   int ind;
   double radius;
@@ -137,13 +167,52 @@ generate_field(field *temperature)
   }
 }
 
+template void
+generate_field(basic_field<float> *temperature);
+template void
+generate_field(basic_field<double> *temperature);
+template void
+generate_field(basic_field<fixed16> *temperature);
+
 /* Set dimensions of the field. Note that the nx is the size of the first
  * dimension and ny the second. */
+template <typename T>
 void
-set_field_dimensions(field *temperature, int nx, int ny)
+set_field_dimensions(basic_field<T> *temperature, int nx, int ny)
 {
   temperature->dx = DX;
   temperature->dy = DY;
   temperature->nx = nx;
   temperature->ny = ny;
 }
+
+template void
+set_field_dimensions(basic_field<float> *temperature, int nx, int ny);
+template void
+set_field_dimensions(basic_field<double> *temperature, int nx, int ny);
+template void
+set_field_dimensions(basic_field<fixed16> *temperature, int nx, int ny);
+
+/* Read an integer tuning parameter from the environment variable name.
+ * The fallback value is returned if the variable is not set. */
+int
+parameter_from_env(const char *name, int fallback)
+{
+  const char *value = getenv(name);
+  if (value == nullptr) {
+    return fallback;
+  }
+  return atoi(value);
+}
+
+/* Read a floating-point tuning parameter from the environment variable name.
+ * The fallback value is returned if the variable is not set. */
+double
+parameter_from_env(const char *name, double fallback)
+{
+  const char *value = getenv(name);
+  if (value == nullptr) {
+    return fallback;
+  }
+  return atof(value);
+}
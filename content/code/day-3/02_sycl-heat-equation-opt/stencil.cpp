@@ -0,0 +1,300 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Generic tiled stencil kernel for heat equation solver
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <utility>
+
+#include <sycl/sycl.hpp>
+
+#include "heat.h"
+#include "stencil.h"
+
+using namespace sycl;
+
+// Update the temperature values with an explicit Euler step of the stencil.
+// The fields have ghost layers as wide as the radius R of the stencil, so
+// that the interior runs from R to R + n - 1 in both dimensions. Each
+// work-group loads its tile of prev with a halo of width R into local
+// memory once. The loops over the stencil have compile-time bounds and
+// weights, so they unroll and the points with zero weight drop out.
+// The points closer to the boundary than the radius of a wider stencil use
+// the five-point stencil instead, as the wider one would reach past the
+// fixed boundary values into ghost layers that do not follow the solution.
+// Arguments:
+//   curr: current temperature values
+//   prev: temperature values from previous time step
+//   a: diffusivity
+//   dt: time step
+//   tile: shape of the work-groups
+template <typename Stencil>
+void
+evolve_stencil(
+  queue &Q,
+  buffer<double, 2> &curr,
+  buffer<double, 2> &prev,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  range<2> tile)
+{
+  constexpr int R = Stencil::radius;
+
+  const int nx = curr.get_range()[0] - 2 * R;
+  const int ny = curr.get_range()[1] - 2 * R;
+
+  const int ty = tile[0];
+  const int tx = tile[1];
+
+  // the global range spans the interior, rounded up to a multiple of the
+  // tile size
+  range global { static_cast<size_t>((nx + ty - 1) / ty * ty),
+                 static_cast<size_t>((ny + tx - 1) / tx * tx) };
+
+  // scaling of the weights on the axes and off them
+  const double inv_dx2 = 1.0 / dx2;
+  const double inv_dy2 = 1.0 / dy2;
+  const double inv_dxy = 1.0 / std::sqrt(dx2 * dy2);
+
+  Q.submit([&](handler &cgh) {
+    auto acc_curr = accessor(curr, cgh, write_only);
+    auto acc_prev = accessor(prev, cgh, read_only);
+
+    // tile of prev, including the halo, in local memory
+    auto tile_prev =
+      local_accessor<double, 2>(range<2>(ty + 2 * R, tx + 2 * R), cgh);
+
+    cgh.parallel_for(nd_range { global, tile }, [=](nd_item<2> it) {
+      // global indices of the upper left corner of the tile with its halo
+      const int j0 = it.get_group(0) * ty;
+      const int i0 = it.get_group(1) * tx;
+
+      const int lj = it.get_local_id(0);
+      const int li = it.get_local_id(1);
+
+      // load the tile with its halo: the work-group is smaller than the
+      // haloed tile, so some work-items load more than one value
+      for (int jj = lj; jj < ty + 2 * R; jj += ty) {
+        for (int ii = li; ii < tx + 2 * R; ii += tx) {
+          if (j0 + jj < nx + 2 * R && i0 + ii < ny + 2 * R) {
+            tile_prev[jj][ii] = acc_prev[j0 + jj][i0 + ii];
+          }
+        }
+      }
+      // synchronize to ensure all work-items have a consistent view of the
+      // local memory holding the tile
+      it.barrier(access::fence_space::local_space);
+
+      const int j = j0 + lj + R;
+      const int i = i0 + li + R;
+      if (j < nx + R && i < ny + R) {
+        const int tj     = lj + R;
+        const int ti     = li + R;
+        const double u_c = tile_prev[tj][ti];
+
+        // distance to the nearest boundary, 1 on the first interior row or
+        // column
+        const int distance = std::min(
+          std::min(j - R + 1, nx + R - j),
+          std::min(i - R + 1, ny + R - i));
+
+        double laplacian = 0.0;
+        if (R > 1 && distance < R) {
+          // five-point stencil next to the boundary
+          laplacian = inv_dx2 * (tile_prev[tj][ti + 1] - u_c) +
+                      inv_dx2 * (tile_prev[tj][ti - 1] - u_c) +
+                      inv_dy2 * (tile_prev[tj + 1][ti] - u_c) +
+                      inv_dy2 * (tile_prev[tj - 1][ti] - u_c);
+        } else {
+          for (int oj = -R; oj <= R; oj++) {
+            for (int oi = -R; oi <= R; oi++) {
+              const double w = Stencil::weight(oj, oi);
+              if ((oj == 0 && oi == 0) || w == 0.0) {
+                continue;
+              }
+              const double scale =
+                oj == 0 ? inv_dx2 : oi == 0 ? inv_dy2 : inv_dxy;
+              laplacian += w * scale * (tile_prev[tj + oj][ti + oi] - u_c);
+            }
+          }
+        }
+
+        acc_curr[j][i] = u_c + a * dt * laplacian;
+      }
+    });
+  });
+}
+
+template void
+evolve_stencil<five_point_stencil>(
+  queue &Q,
+  buffer<double, 2> &curr,
+  buffer<double, 2> &prev,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  range<2> tile);
+
+template void
+evolve_stencil<nine_point_stencil>(
+  queue &Q,
+  buffer<double, 2> &curr,
+  buffer<double, 2> &prev,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  range<2> tile);
+
+template void
+evolve_stencil<fourth_order_stencil>(
+  queue &Q,
+  buffer<double, 2> &curr,
+  buffer<double, 2> &prev,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  range<2> tile);
+
+// Copy a field with a single ghost layer into one with radius ghost layers.
+// The extra ghost layers repeat the boundary values outwards. They only
+// fill the halos of the tiles, as the points next to the boundary are
+// updated with the five-point stencil, which reads the fixed boundary
+// values of the first ghost layer.
+void
+pad_field(
+  queue &Q,
+  buffer<double, 2> &temperature,
+  buffer<double, 2> &padded,
+  int radius)
+{
+  const int nx = temperature.get_range()[0] - 2;
+  const int ny = temperature.get_range()[1] - 2;
+
+  Q.submit([&](handler &cgh) {
+    auto acc        = accessor(temperature, cgh, read_only);
+    auto acc_padded = accessor(padded, cgh, write_only, no_init);
+
+    cgh.parallel_for(padded.get_range(), [=](id<2> id) {
+      const int j = std::clamp(static_cast<int>(id[0]) - radius + 1, 0, nx + 1);
+      const int i = std::clamp(static_cast<int>(id[1]) - radius + 1, 0, ny + 1);
+      acc_padded[id] = acc[j][i];
+    });
+  });
+}
+
+// Copy the interior of a field with radius ghost layers back into one with
+// a single ghost layer
+void
+unpad_field(
+  queue &Q,
+  buffer<double, 2> &padded,
+  buffer<double, 2> &temperature,
+  int radius)
+{
+  const int nx = temperature.get_range()[0] - 2;
+  const int ny = temperature.get_range()[1] - 2;
+
+  Q.submit([&](handler &cgh) {
+    auto acc_padded = accessor(padded, cgh, read_only);
+    auto acc        = accessor(temperature, cgh, write_only);
+
+    cgh.parallel_for(range<2>(nx, ny), [=](id<2> id) {
+      acc[id[0] + 1][id[1] + 1] = acc_padded[id[0] + radius][id[1] + radius];
+    });
+  });
+}
+
+// Integrate over the given time with the stencil, using the largest stable
+// time step that evenly divides the time
+template <typename Stencil>
+static int
+integrate(
+  queue &Q,
+  buffer<double, 2> &temperature,
+  double a,
+  double time,
+  double dx2,
+  double dy2,
+  range<2> tile)
+{
+  constexpr int R = Stencil::radius;
+
+  const double dt_max = stable_time_step<Stencil>(a, dx2, dy2);
+  const int nsteps = static_cast<int>(std::ceil(time / dt_max - 1.0e-12));
+  const double dt = time / nsteps;
+
+  range<2> extent { temperature.get_range()[0] + 2 * (R - 1),
+                    temperature.get_range()[1] + 2 * (R - 1) };
+  buffer<double, 2> curr { extent }, prev { extent };
+  pad_field(Q, temperature, curr, R);
+  pad_field(Q, temperature, prev, R);
+
+  for (int iter = 1; iter <= nsteps; iter++) {
+    evolve_stencil<Stencil>(Q, curr, prev, a, dt, dx2, dy2, tile);
+    std::swap(curr, prev);
+  }
+
+  unpad_field(Q, prev, temperature, R);
+
+  return nsteps;
+}
+
+// Integrate the temperature over the given time with the selected stencil,
+// starting from and ending in a field with a single ghost layer
+// Returns:
+//   the number of time steps taken
+int
+integrate_stencil(
+  queue &Q,
+  buffer<double, 2> &temperature,
+  stencil_kind kind,
+  double a,
+  double time,
+  double dx2,
+  double dy2,
+  range<2> tile)
+{
+  switch (kind) {
+    case stencil_kind::nine_point:
+      return integrate<nine_point_stencil>(
+        Q, temperature, a, time, dx2, dy2, tile);
+    case stencil_kind::fourth_order:
+      return integrate<fourth_order_stencil>(
+        Q, temperature, a, time, dx2, dy2, tile);
+    case stencil_kind::five_point:
+      return integrate<five_point_stencil>(
+        Q, temperature, a, time, dx2, dy2, tile);
+    default:
+      printf(
+        "Unknown stencil %d, available ones are: 1 (five-point), "
+        "2 (nine-point), 3 (fourth-order)\n",
+        static_cast<int>(kind));
+      exit(-1);
+  }
+}
@@ -0,0 +1,145 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Compile-time stencils for the Laplacian and the kernel engine built on them
+
+#pragma once
+
+#include <cmath>
+
+#include <sycl/sycl.hpp>
+
+// A stencil is a type giving its radius and the weights of its off-center
+// points as compile-time constants. The weight of the point at offset
+// (oj, oi) is in units of 1 / dx^2 on the i axis, 1 / dy^2 on the j axis and
+// 1 / (dx dy) off the axes. The center weight follows from the weights
+// summing to zero, as the Laplacian of a constant vanishes, so that the
+// kernel sums the differences to the center value.
+
+// Second-order five-point Laplacian
+struct five_point_stencil
+{
+  static constexpr int radius = 1;
+
+  static constexpr double
+  weight(int oj, int oi)
+  {
+    return (oj == 0) != (oi == 0) ? 1.0 : 0.0;
+  }
+};
+
+// Second-order isotropic nine-point Laplacian, whose leading error term
+// does not depend on the direction. It assumes square grid cells.
+struct nine_point_stencil
+{
+  static constexpr int radius = 1;
+
+  static constexpr double
+  weight(int oj, int oi)
+  {
+    return (oj == 0) != (oi == 0) ? 2.0 / 3.0 : 1.0 / 6.0;
+  }
+};
+
+// Fourth-order Laplacian reaching two points along each axis
+struct fourth_order_stencil
+{
+  static constexpr int radius = 2;
+
+  static constexpr double
+  weight(int oj, int oi)
+  {
+    if (oj != 0 && oi != 0) {
+      return 0.0;
+    }
+    return (oj + oi == 1 || oj + oi == -1) ? 4.0 / 3.0 : -1.0 / 12.0;
+  }
+};
+
+// Stencils selectable at run time
+enum class stencil_kind
+{
+  five_point   = 1,
+  nine_point   = 2,
+  fourth_order = 3
+};
+
+// Largest stable time step of explicit Euler with the given stencil. The
+// largest eigenvalue of the stencil is bounded by twice the sum of the
+// magnitudes of its off-center weights; the bound is exact for the
+// five-point stencil, for which this is the usual time step.
+template <typename Stencil>
+inline double
+stable_time_step(double a, double dx2, double dy2)
+{
+  constexpr int R = Stencil::radius;
+
+  double sum = 0.0;
+  for (int oj = -R; oj <= R; oj++) {
+    for (int oi = -R; oi <= R; oi++) {
+      if (oj == 0 && oi == 0) {
+        continue;
+      }
+      const double scale = oj == 0 ? dx2 : oi == 0 ? dy2 : std::sqrt(dx2 * dy2);
+      const double w     = Stencil::weight(oj, oi);
+      sum += (w < 0.0 ? -w : w) / scale;
+    }
+  }
+  return 1.0 / (a * sum);
+}
+
+// Function prototypes
+template <typename Stencil>
+void
+evolve_stencil(
+  sycl::queue &Q,
+  sycl::buffer<double, 2> &curr,
+  sycl::buffer<double, 2> &prev,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  sycl::range<2> tile);
+
+void
+pad_field(
+  sycl::queue &Q,
+  sycl::buffer<double, 2> &temperature,
+  sycl::buffer<double, 2> &padded,
+  int radius);
+
+void
+unpad_field(
+  sycl::queue &Q,
+  sycl::buffer<double, 2> &padded,
+  sycl::buffer<double, 2> &temperature,
+  int radius);
+
+int
+integrate_stencil(
+  sycl::queue &Q,
+  sycl::buffer<double, 2> &temperature,
+  stencil_kind kind,
+  double a,
+  double time,
+  double dx2,
+  double dy2,
+  sycl::range<2> tile);
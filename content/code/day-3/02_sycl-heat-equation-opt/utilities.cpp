@@ -23,6 +23,7 @@
 
 #include <cassert>
 #include <cstdlib>
+#include <limits>
 
 #include <sycl/sycl.hpp>
 
@@ -31,8 +32,9 @@
 using namespace sycl;
 
 // Copy data on temperature1 into temperature2
+template <typename T>
 void
-copy_field(field *temperature1, field *temperature2)
+copy_field(basic_field<T> *temperature1, basic_field<T> *temperature2)
 {
   assert(temperature1->nx == temperature2->nx);
   assert(temperature1->ny == temperature2->ny);
@@ -43,31 +45,72 @@ copy_field(field *temperature1, field *temperature2)
     temperature2->data.begin());
 }
 
+template void
+copy_field(basic_field<float> *temperature1, basic_field<float> *temperature2);
+template void
+copy_field(
+  basic_field<double> *temperature1,
+  basic_field<double> *temperature2);
+template void
+copy_field(
+  basic_field<fixed16> *temperature1,
+  basic_field<fixed16> *temperature2);
+
 // Swap the field data for temperature1 and temperature2
+template <typename T>
 void
-swap_fields(field *temperature1, field *temperature2)
+swap_fields(basic_field<T> *temperature1, basic_field<T> *temperature2)
 {
   std::swap(temperature1->data, temperature2->data);
 }
 
+template void
+swap_fields(basic_field<float> *temperature1, basic_field<float> *temperature2);
+template void
+swap_fields(
+  basic_field<double> *temperature1,
+  basic_field<double> *temperature2);
+template void
+swap_fields(
+  basic_field<fixed16> *temperature1,
+  basic_field<fixed16> *temperature2);
+
+template <typename T>
 void
-swap_fields(buffer<double, 2> &temperature1, buffer<double, 2> &temperature2)
+swap_fields(buffer<T, 2> &temperature1, buffer<T, 2> &temperature2)
 {
   std::swap(temperature1, temperature2);
 }
 
+template void
+swap_fields(buffer<float, 2> &temperature1, buffer<float, 2> &temperature2);
+template void
+swap_fields(buffer<fixed16, 2> &temperature1, buffer<fixed16, 2> &temperature2);
+template void
+swap_fields(buffer<double, 2> &temperature1, buffer<double, 2> &temperature2);
+
 // Allocate memory for a temperature field and initialise it to zero
+template <typename T>
 void
-allocate_field(field *temperature)
+allocate_field(basic_field<T> *temperature)
 {
   // Include also boundary layers
   int newSize = (temperature->nx + 2) * (temperature->ny + 2);
   temperature->data.resize(newSize, 0.0);
 }
 
-// Calculate average temperature over the non-boundary grid cells
+template void
+allocate_field(basic_field<float> *temperature);
+template void
+allocate_field(basic_field<double> *temperature);
+template void
+allocate_field(basic_field<fixed16> *temperature);
+
+// Calculate average temperature over the non-boundary grid cells. The sum
+// is accumulated in double precision whatever the storage type.
+template <typename T>
 double
-average(field *temperature)
+average(basic_field<T> *temperature)
 {
   double average = 0.0;
 
@@ -81,3 +124,101 @@ average(field *temperature)
   average /= (temperature->nx * temperature->ny);
   return average;
 }
+
+template double
+average(basic_field<float> *temperature);
+template double
+average(basic_field<double> *temperature);
+template double
+average(basic_field<fixed16> *temperature);
+
+// Calculate sum, minimum and maximum of the temperature over the
+// non-boundary grid cells of a field held in a buffer.
+// Each work-item sums one row with compensated (Kahan) summation and the
+// row sums are then combined by the reduction, so that the result does not
+// depend on rounding errors piling up along the rows. Only the three
+// scalars are copied back to the host.
+template <typename T>
+field_statistics
+statistics(queue &Q, buffer<T, 2> &temperature)
+{
+  const int nx = temperature.get_range()[0] - 2;
+  const int ny = temperature.get_range()[1] - 2;
+
+  field_statistics stats { 0.0,
+                           std::numeric_limits<double>::max(),
+                           std::numeric_limits<double>::lowest() };
+
+  // the reduction variables live in device memory
+  auto d_stats = malloc_device<field_statistics>(1, Q);
+  Q.copy(&stats, d_stats, 1).wait();
+
+  Q.submit([&](handler &cgh) {
+    auto acc = accessor(temperature, cgh, read_only);
+
+    auto sum_red = reduction(&d_stats->sum, plus<double>());
+    auto min_red = reduction(&d_stats->min, minimum<double>());
+    auto max_red = reduction(&d_stats->max, maximum<double>());
+
+    cgh.parallel_for(
+      range<1>(nx),
+      sum_red,
+      min_red,
+      max_red,
+      [=](id<1> id, auto &sum, auto &min, auto &max) {
+        const int j = id[0] + 1;
+
+        double row_sum = 0.0;
+        // running compensation for the low-order bits lost in row_sum
+        double c       = 0.0;
+        double row_min = std::numeric_limits<double>::max();
+        double row_max = std::numeric_limits<double>::lowest();
+        for (int i = 1; i < ny + 1; i++) {
+          const double value = acc[j][i];
+
+          const double y = value - c;
+          const double t = row_sum + y;
+          c              = (t - row_sum) - y;
+          row_sum        = t;
+
+          row_min = sycl::fmin(row_min, value);
+          row_max = sycl::fmax(row_max, value);
+        }
+
+        sum += row_sum;
+        min.combine(row_min);
+        max.combine(row_max);
+      });
+  }).wait();
+
+  Q.copy(d_stats, &stats, 1).wait();
+
+  free(d_stats, Q);
+
+  return stats;
+}
+
+template field_statistics
+statistics(queue &Q, buffer<float, 2> &temperature);
+template field_statistics
+statistics(queue &Q, buffer<double, 2> &temperature);
+template field_statistics
+statistics(queue &Q, buffer<fixed16, 2> &temperature);
+
+// Calculate average temperature over the non-boundary grid cells of a field
+// held in a buffer
+template <typename T>
+double
+average(queue &Q, buffer<T, 2> &temperature)
+{
+  auto nx = temperature.get_range()[0] - 2;
+  auto ny = temperature.get_range()[1] - 2;
+  return statistics(Q, temperature).sum / (nx * ny);
+}
+
+template double
+average(queue &Q, buffer<float, 2> &temperature);
+template double
+average(queue &Q, buffer<double, 2> &temperature);
+template double
+average(queue &Q, buffer<fixed16, 2> &temperature);
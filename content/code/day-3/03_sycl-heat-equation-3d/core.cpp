@@ -0,0 +1,324 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Main solver routines for 3D heat equation solver
+
+#include "heat.h"
+
+#include <sycl/sycl.hpp>
+
+using namespace sycl;
+
+// The kernels are written against two callables, prev(k, j, i) returning the
+// old value and curr(k, j, i) returning a reference to the new one, so that
+// the same code serves both buffer accessors and USM pointers.
+
+// Submit the straightforward seven-point stencil, one work-item per grid
+// point. Every value is read seven times from global memory, so the kernel
+// relies entirely on the caches.
+template <typename Prev, typename Curr>
+static void
+stencil(
+  handler &cgh,
+  Prev prev,
+  Curr curr,
+  size_t nx,
+  size_t ny,
+  size_t nz,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  double dz2)
+{
+  cgh.parallel_for(range<3>(nz, ny, nx), [=](id<3> id) {
+    auto k = id[0] + 1;
+    auto j = id[1] + 1;
+    auto i = id[2] + 1;
+
+    curr(k, j, i) =
+      prev(k, j, i) +
+      a * dt *
+        ((prev(k, j, i + 1) - 2.0 * prev(k, j, i) + prev(k, j, i - 1)) / dx2 +
+         (prev(k, j + 1, i) - 2.0 * prev(k, j, i) + prev(k, j - 1, i)) / dy2 +
+         (prev(k + 1, j, i) - 2.0 * prev(k, j, i) + prev(k - 1, j, i)) / dz2);
+  });
+}
+
+// Submit the seven-point stencil with 2.5D blocking. The work-groups tile
+// the xy plane and march along z. At each height the work-group keeps the
+// plane of its tile, with a one-point halo, in local memory, while each
+// work-item holds the values just below and above its point in registers.
+// Each value of the field is then loaded from global memory about once per
+// time step instead of seven times, apart from the halo.
+template <typename Prev, typename Curr>
+static void
+stencil_blocked(
+  handler &cgh,
+  Prev prev,
+  Curr curr,
+  size_t nx,
+  size_t ny,
+  size_t nz,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  double dz2,
+  range<2> tile)
+{
+  const auto ty = tile[0];
+  const auto tx = tile[1];
+
+  // the plane of the tile with its halo
+  local_accessor<double, 2> plane { range<2> { ty + 2, tx + 2 }, cgh };
+
+  // round the global range up to whole tiles
+  range<2> global { (ny + ty - 1) / ty * ty, (nx + tx - 1) / tx * tx };
+
+  cgh.parallel_for(nd_range<2>(global, tile), [=](nd_item<2> item) {
+    const auto lj = item.get_local_id(0);
+    const auto li = item.get_local_id(1);
+    // work-items outside the grid load clamped values, and take part in the
+    // barriers, but do not store anything
+    const auto j      = item.get_global_id(0) + 1;
+    const auto i      = item.get_global_id(1) + 1;
+    const bool inside = j <= ny && i <= nx;
+    const auto jc     = sycl::min(j, ny + 1);
+    const auto ic     = sycl::min(i, nx + 1);
+
+    double below  = prev(0, jc, ic);
+    double center = prev(1, jc, ic);
+
+    for (size_t k = 1; k <= nz; k++) {
+      const double above = prev(k + 1, jc, ic);
+
+      // wait until everyone is done with the previous plane
+      group_barrier(item.get_group());
+      plane[lj + 1][li + 1] = center;
+      if (lj == 0) {
+        plane[0][li + 1] = prev(k, jc - 1, ic);
+      }
+      if (lj == ty - 1) {
+        plane[ty + 1][li + 1] = prev(k, sycl::min(jc + 1, ny + 1), ic);
+      }
+      if (li == 0) {
+        plane[lj + 1][0] = prev(k, jc, ic - 1);
+      }
+      if (li == tx - 1) {
+        plane[lj + 1][tx + 1] = prev(k, jc, sycl::min(ic + 1, nx + 1));
+      }
+      group_barrier(item.get_group());
+
+      if (inside) {
+        curr(k, j, i) =
+          center +
+          a * dt *
+            ((plane[lj + 1][li + 2] - 2.0 * center + plane[lj + 1][li]) / dx2 +
+             (plane[lj + 2][li + 1] - 2.0 * center + plane[lj][li + 1]) / dy2 +
+             (above - 2.0 * center + below) / dz2);
+      }
+
+      below  = center;
+      center = above;
+    }
+  });
+}
+
+// Update the temperature values using seven-point stencil
+// Arguments:
+//   curr: current temperature values
+//   prev: temperature values from previous time step
+//   a: diffusivity
+//   dt: time step
+void
+evolve(
+  queue &Q,
+  buffer<double, 3> &curr,
+  buffer<double, 3> &prev,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  double dz2)
+{
+  auto nz = curr.get_range()[0] - 2;
+  auto ny = curr.get_range()[1] - 2;
+  auto nx = curr.get_range()[2] - 2;
+
+  // As we have fixed boundary conditions, the outermost gridpoints
+  // are not updated.
+  Q.submit([&](handler &cgh) {
+    auto acc_curr = accessor(curr, cgh, read_write);
+    auto acc_prev = accessor(prev, cgh, read_only);
+
+    auto prev_value = [=](size_t k, size_t j, size_t i) {
+      return acc_prev[k][j][i];
+    };
+    auto curr_value = [=](size_t k, size_t j, size_t i) -> double & {
+      return acc_curr[k][j][i];
+    };
+    stencil(cgh, prev_value, curr_value, nx, ny, nz, a, dt, dx2, dy2, dz2);
+  });
+}
+
+// Update the temperature values using seven-point stencil, with the fields
+// in USM device allocations
+// Arguments:
+//   temperature: dimensions and grid spacing of the fields
+//   curr: current temperature values
+//   prev: temperature values from previous time step
+//   a: diffusivity
+//   dt: time step
+void
+evolve(
+  queue &Q,
+  const field *temperature,
+  double *curr,
+  const double *prev,
+  double a,
+  double dt)
+{
+  const auto t   = *temperature;
+  const auto dx2 = t.dx * t.dx;
+  const auto dy2 = t.dy * t.dy;
+  const auto dz2 = t.dz * t.dz;
+
+  auto prev_value = [=](size_t k, size_t j, size_t i) {
+    return prev[field_index(t, k, j, i)];
+  };
+  auto curr_value = [=](size_t k, size_t j, size_t i) -> double & {
+    return curr[field_index(t, k, j, i)];
+  };
+
+  Q.submit([&](handler &cgh) {
+    stencil(
+      cgh,
+      prev_value,
+      curr_value,
+      t.nx,
+      t.ny,
+      t.nz,
+      a,
+      dt,
+      dx2,
+      dy2,
+      dz2);
+  });
+}
+
+// Update the temperature values using seven-point stencil with 2.5D
+// blocking
+// Arguments:
+//   curr: current temperature values
+//   prev: temperature values from previous time step
+//   a: diffusivity
+//   dt: time step
+//   tile: shape of the work-groups in the yx plane
+void
+evolve_blocked(
+  queue &Q,
+  buffer<double, 3> &curr,
+  buffer<double, 3> &prev,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  double dz2,
+  range<2> tile)
+{
+  auto nz = curr.get_range()[0] - 2;
+  auto ny = curr.get_range()[1] - 2;
+  auto nx = curr.get_range()[2] - 2;
+
+  Q.submit([&](handler &cgh) {
+    auto acc_curr = accessor(curr, cgh, read_write);
+    auto acc_prev = accessor(prev, cgh, read_only);
+
+    auto prev_value = [=](size_t k, size_t j, size_t i) {
+      return acc_prev[k][j][i];
+    };
+    auto curr_value = [=](size_t k, size_t j, size_t i) -> double & {
+      return acc_curr[k][j][i];
+    };
+    stencil_blocked(
+      cgh,
+      prev_value,
+      curr_value,
+      nx,
+      ny,
+      nz,
+      a,
+      dt,
+      dx2,
+      dy2,
+      dz2,
+      tile);
+  });
+}
+
+// Update the temperature values using seven-point stencil with 2.5D
+// blocking, with the fields in USM device allocations
+// Arguments:
+//   temperature: dimensions and grid spacing of the fields
+//   curr: current temperature values
+//   prev: temperature values from previous time step
+//   a: diffusivity
+//   dt: time step
+//   tile: shape of the work-groups in the yx plane
+void
+evolve_blocked(
+  queue &Q,
+  const field *temperature,
+  double *curr,
+  const double *prev,
+  double a,
+  double dt,
+  range<2> tile)
+{
+  const auto t   = *temperature;
+  const auto dx2 = t.dx * t.dx;
+  const auto dy2 = t.dy * t.dy;
+  const auto dz2 = t.dz * t.dz;
+
+  auto prev_value = [=](size_t k, size_t j, size_t i) {
+    return prev[field_index(t, k, j, i)];
+  };
+  auto curr_value = [=](size_t k, size_t j, size_t i) -> double & {
+    return curr[field_index(t, k, j, i)];
+  };
+
+  Q.submit([&](handler &cgh) {
+    stencil_blocked(
+      cgh,
+      prev_value,
+      curr_value,
+      t.nx,
+      t.ny,
+      t.nz,
+      a,
+      dt,
+      dx2,
+      dy2,
+      dz2,
+      tile);
+  });
+}
@@ -0,0 +1,134 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <sycl/sycl.hpp>
+
+// Datatype for a 3D temperature field. The values themselves live in
+// device memory, either in a buffer or in a USM allocation.
+struct field
+{
+  // nx, ny and nz are the dimensions of the field along x, y and z. The
+  // values are stored with z as the slowest and x as the fastest running
+  // index, and contain also ghost layers, so the array will have dimensions
+  // nz+2 x ny+2 x nx+2
+  int nx;
+  int ny;
+  int nz;
+  // Size of the grid cells
+  double dx;
+  double dy;
+  double dz;
+};
+
+// Index of the point (k, j, i) in a flat array holding the field
+inline size_t
+field_index(const field &temperature, size_t k, size_t j, size_t i)
+{
+  return (k * (temperature.ny + 2) + j) * (temperature.nx + 2) + i;
+}
+
+// We use here fixed grid spacing
+constexpr auto DX = 0.01;
+constexpr auto DY = 0.01;
+constexpr auto DZ = 0.01;
+
+// Function prototypes
+void
+set_field_dimensions(field *temperature, int nx, int ny, int nz);
+
+void
+initialize(int argc, char *argv[], field *temperature, int *nsteps);
+
+void
+generate_field(
+  sycl::queue &Q,
+  const field *temperature,
+  sycl::buffer<double, 3> &data);
+
+void
+generate_field(sycl::queue &Q, const field *temperature, double *data);
+
+int
+parameter_from_env(const char *name, int fallback);
+
+double
+average(sycl::queue &Q, sycl::buffer<double, 3> &data);
+
+double
+average(sycl::queue &Q, const field *temperature, const double *data);
+
+void
+evolve(
+  sycl::queue &Q,
+  sycl::buffer<double, 3> &curr,
+  sycl::buffer<double, 3> &prev,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  double dz2);
+
+void
+evolve(
+  sycl::queue &Q,
+  const field *temperature,
+  double *curr,
+  const double *prev,
+  double a,
+  double dt);
+
+void
+evolve_blocked(
+  sycl::queue &Q,
+  sycl::buffer<double, 3> &curr,
+  sycl::buffer<double, 3> &prev,
+  double a,
+  double dt,
+  double dx2,
+  double dy2,
+  double dz2,
+  sycl::range<2> tile);
+
+void
+evolve_blocked(
+  sycl::queue &Q,
+  const field *temperature,
+  double *curr,
+  const double *prev,
+  double a,
+  double dt,
+  sycl::range<2> tile);
+
+void
+write_slice(
+  sycl::queue &Q,
+  const field *temperature,
+  sycl::buffer<double, 3> &data,
+  int iter);
+
+void
+write_slice(
+  sycl::queue &Q,
+  const field *temperature,
+  const double *data,
+  int iter);
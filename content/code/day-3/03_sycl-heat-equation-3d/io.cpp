@@ -0,0 +1,99 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// I/O related functions for 3D heat equation solver
+
+#include <cstdio>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+
+#include "heat.h"
+#include "pngwriter.h"
+
+using namespace sycl;
+
+// Write the interior of the xy plane through the middle of the field to
+// a png file. The plane is given with its ghost layers.
+static void
+save_slice(const field *temperature, const std::vector<double> &plane, int iter)
+{
+  char filename[64];
+
+  const int nx = temperature->nx;
+  const int ny = temperature->ny;
+
+  // The actual write routine takes only the actual data
+  // (without boundary layers) so we need to copy an array with that.
+  std::vector<double> inner_data(nx * ny);
+  for (int j = 0; j < ny; j++) {
+    auto beginning_of_row = plane.begin() + (j + 1) * (nx + 2) + 1;
+    std::copy(
+      beginning_of_row, beginning_of_row + nx, inner_data.begin() + j * nx);
+  }
+
+  // Write out the data to a png file
+  sprintf(filename, "%s_%04d.png", "heat", iter);
+  save_png(inner_data.data(), ny, nx, filename);
+}
+
+// Output routine that prints out a picture of the temperature distribution
+// in the xy plane through the middle of the field
+void
+write_slice(
+  queue &Q,
+  const field *temperature,
+  buffer<double, 3> &data,
+  int iter)
+{
+  const auto t = *temperature;
+  const int k  = t.nz / 2 + 1;
+
+  std::vector<double> plane((t.ny + 2) * (t.nx + 2));
+  {
+    // only the plane is copied, not the whole field
+    buffer<double, 2> buf_plane { plane.data(),
+                                  range<2>(t.ny + 2, t.nx + 2) };
+    Q.submit([&](handler &cgh) {
+      auto acc       = accessor(data, cgh, read_only);
+      auto acc_plane = accessor(buf_plane, cgh, write_only, no_init);
+      cgh.parallel_for(buf_plane.get_range(), [=](id<2> id) {
+        acc_plane[id] = acc[k][id[0]][id[1]];
+      });
+    });
+  }
+
+  save_slice(temperature, plane, iter);
+}
+
+// Output routine for a field in a USM device allocation
+void
+write_slice(queue &Q, const field *temperature, const double *data, int iter)
+{
+  const auto t = *temperature;
+  const int k  = t.nz / 2 + 1;
+
+  // the planes are contiguous in memory
+  std::vector<double> plane((t.ny + 2) * (t.nx + 2));
+  Q.copy(data + field_index(t, k, 0, 0), plane.data(), plane.size()).wait();
+
+  save_slice(temperature, plane, iter);
+}
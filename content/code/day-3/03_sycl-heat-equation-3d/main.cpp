@@ -0,0 +1,157 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Main routine for heat equation solver in 3D.
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <utility>
+
+#include <sycl/sycl.hpp>
+
+#include "heat.h"
+
+using namespace sycl;
+
+int
+main(int argc, char **argv)
+{
+  // Number of time steps
+  int nsteps;
+  // Dimensions of the temperature fields
+  field temperature;
+  initialize(argc, argv, &temperature, &nsteps);
+
+  // Diffusion constant
+  double a = 0.5;
+
+  // Compute the largest stable time step
+  double dx2 = temperature.dx * temperature.dx;
+  double dy2 = temperature.dy * temperature.dy;
+  double dz2 = temperature.dz * temperature.dz;
+  // Time step
+  double dt = 1.0 / (2.0 * a * (1.0 / dx2 + 1.0 / dy2 + 1.0 / dz2));
+
+  auto nx = static_cast<size_t>(temperature.nx);
+  auto ny = static_cast<size_t>(temperature.ny);
+  auto nz = static_cast<size_t>(temperature.nz);
+
+  // Keep the fields in USM device allocations instead of buffers
+  bool usm = parameter_from_env("HEAT_USM", 0) != 0;
+  // Use the 2.5D blocked stencil, which marches along z through tiles of
+  // the xy plane
+  bool blocked = parameter_from_env("HEAT_BLOCKED", 1) != 0;
+  // Shape of the work-group tiles of the blocked stencil
+  range<2> tile { static_cast<size_t>(parameter_from_env("HEAT_TILE_Y", 8)),
+                  static_cast<size_t>(parameter_from_env("HEAT_TILE_X", 32)) };
+
+  using wall_clock_t = std::chrono::high_resolution_clock;
+
+  decltype(wall_clock_t::now()) start, stop;
+
+  double average_temp;
+
+  // create a queue, in order so that the USM kernels on the same fields
+  // follow each other
+  queue Q { property::queue::in_order() };
+
+  if (usm) {
+    auto size   = (nz + 2) * (ny + 2) * (nx + 2);
+    auto d_curr = malloc_device<double>(size, Q);
+    auto d_prev = malloc_device<double>(size, Q);
+
+    // Both fields start out with the same values, boundaries included
+    generate_field(Q, &temperature, d_curr);
+    generate_field(Q, &temperature, d_prev);
+    Q.wait();
+
+    // Output the initial field
+    write_slice(Q, &temperature, d_prev, 0);
+
+    average_temp = average(Q, &temperature, d_prev);
+    printf("Average temperature at start: %f\n", average_temp);
+
+    start = wall_clock_t::now();
+    // Time evolution
+    for (int iter = 1; iter <= nsteps; iter++) {
+      if (blocked) {
+        evolve_blocked(Q, &temperature, d_curr, d_prev, a, dt, tile);
+      } else {
+        evolve(Q, &temperature, d_curr, d_prev, a, dt);
+      }
+      // Swap current field so that it will be used
+      // as previous for next iteration step
+      std::swap(d_curr, d_prev);
+    }
+    Q.wait();
+    stop = wall_clock_t::now();
+
+    average_temp = average(Q, &temperature, d_prev);
+
+    // Output the final field
+    write_slice(Q, &temperature, d_prev, nsteps);
+
+    free(d_curr, Q);
+    free(d_prev, Q);
+  } else {
+    // create buffers for current and previous fields
+    buffer<double, 3> buf_curr { range<3> { nz + 2, ny + 2, nx + 2 } },
+      buf_prev { range<3> { nz + 2, ny + 2, nx + 2 } };
+
+    // Both fields start out with the same values, boundaries included
+    generate_field(Q, &temperature, buf_curr);
+    generate_field(Q, &temperature, buf_prev);
+
+    // Output the initial field
+    write_slice(Q, &temperature, buf_prev, 0);
+
+    average_temp = average(Q, buf_prev);
+    printf("Average temperature at start: %f\n", average_temp);
+
+    start = wall_clock_t::now();
+    // Time evolution
+    for (int iter = 1; iter <= nsteps; iter++) {
+      if (blocked) {
+        evolve_blocked(Q, buf_curr, buf_prev, a, dt, dx2, dy2, dz2, tile);
+      } else {
+        evolve(Q, buf_curr, buf_prev, a, dt, dx2, dy2, dz2);
+      }
+      // Swap current field so that it will be used
+      // as previous for next iteration step
+      std::swap(buf_curr, buf_prev);
+    }
+    Q.wait();
+    stop = wall_clock_t::now();
+
+    average_temp = average(Q, buf_prev);
+
+    // Output the final field
+    write_slice(Q, &temperature, buf_prev, nsteps);
+  }
+
+  // Determine the CPU time used for all the iterations
+  std::chrono::duration<float> elapsed = stop - start;
+  printf("Iterations took %.3f seconds.\n", elapsed.count());
+  printf("Average temperature: %f\n", average_temp);
+
+  return 0;
+}
@@ -0,0 +1,158 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Setup routines for 3D heat equation solver */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <sycl/sycl.hpp>
+
+#include "heat.h"
+
+using namespace sycl;
+
+// Default number of iteration steps
+constexpr auto NSTEPS = 100;
+
+/* Initialize the heat equation solver */
+void
+initialize(int argc, char *argv[], field *temperature, int *nsteps)
+{
+  /*
+   * Following combinations of command line arguments are possible:
+   * No arguments:    use default field dimensions and number of time steps
+   * Four arguments:  field dimensions (x,y,z) and number of time steps
+   * The initial field itself is generated on the device.
+   */
+
+  int nx = 256; //!< Field dimensions with default values
+  int ny = 256;
+  int nz = 256;
+
+  *nsteps = NSTEPS;
+
+  switch (argc) {
+    case 1:
+      /* Use default values */
+      break;
+    case 5:
+      /* Field dimensions */
+      nx = atoi(argv[1]);
+      ny = atoi(argv[2]);
+      nz = atoi(argv[3]);
+      /* Number of time steps */
+      *nsteps = atoi(argv[4]);
+      break;
+    default:
+      printf("Unsupported number of command line arguments\n");
+      exit(-1);
+  }
+
+  set_field_dimensions(temperature, nx, ny, nz);
+}
+
+/* Initial temperature at the point (k, j, i). Pattern is a ball with a
+ * radius of nx / 6 in the center of the grid.
+ * Boundary conditions are (different) constant temperatures outside the
+ * grid. */
+static inline double
+initial_temperature(const field &t, int k, int j, int i)
+{
+  if (i == 0) {
+    return 20.0;
+  } else if (i == t.nx + 1) {
+    return 70.0;
+  } else if (j == 0) {
+    return 85.0;
+  } else if (j == t.ny + 1) {
+    return 5.0;
+  } else if (k == 0) {
+    return 50.0;
+  } else if (k == t.nz + 1) {
+    return 35.0;
+  }
+
+  /* Distance of point k, j, i from the origin */
+  const double radius = t.nx / 6.0;
+  const int dx        = i - t.nx / 2 + 1;
+  const int dy        = j - t.ny / 2 + 1;
+  const int dz        = k - t.nz / 2 + 1;
+  if (dx * dx + dy * dy + dz * dz < radius * radius) {
+    return 5.0;
+  } else {
+    return 65.0;
+  }
+}
+
+/* Generate the initial temperature field on the device, one work-item per
+ * grid point, so that the field never has to be set up on the host and
+ * copied over. */
+void
+generate_field(queue &Q, const field *temperature, buffer<double, 3> &data)
+{
+  const auto t = *temperature;
+
+  Q.submit([&](handler &cgh) {
+    auto acc = accessor(data, cgh, write_only, no_init);
+
+    cgh.parallel_for(data.get_range(), [=](id<3> id) {
+      acc[id] = initial_temperature(t, id[0], id[1], id[2]);
+    });
+  });
+}
+
+/* Generate the initial temperature field in a USM device allocation */
+void
+generate_field(queue &Q, const field *temperature, double *data)
+{
+  const auto t = *temperature;
+
+  Q.parallel_for(range<3>(t.nz + 2, t.ny + 2, t.nx + 2), [=](id<3> id) {
+    data[field_index(t, id[0], id[1], id[2])] =
+      initial_temperature(t, id[0], id[1], id[2]);
+  });
+}
+
+/* Set dimensions of the field. Note that nz is the size of the first
+ * (slowest) dimension and nx the last. */
+void
+set_field_dimensions(field *temperature, int nx, int ny, int nz)
+{
+  temperature->dx = DX;
+  temperature->dy = DY;
+  temperature->dz = DZ;
+  temperature->nx = nx;
+  temperature->ny = ny;
+  temperature->nz = nz;
+}
+
+/* Read an integer tuning parameter from the environment variable name.
+ * The fallback value is returned if the variable is not set. */
+int
+parameter_from_env(const char *name, int fallback)
+{
+  const char *value = getenv(name);
+  if (value == nullptr) {
+    return fallback;
+  }
+  return atoi(value);
+}
@@ -0,0 +1,105 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Utility functions for 3D heat equation solver
+
+#include <sycl/sycl.hpp>
+
+#include "heat.h"
+
+using namespace sycl;
+
+// Sum of the temperature over the non-boundary grid cells. Each work-item
+// sums one row along x with compensated (Kahan) summation and the row sums
+// are then combined by the reduction.
+template <typename Data>
+static double
+interior_sum(queue &Q, const field &t, Data data)
+{
+  double sum = 0.0;
+
+  // the reduction variable lives in device memory
+  auto d_sum = malloc_device<double>(1, Q);
+  Q.copy(&sum, d_sum, 1).wait();
+
+  Q.submit([&](handler &cgh) {
+     auto sum_red = reduction(d_sum, plus<double>());
+     // the accessor, if any, is created inside the command group
+     auto values = data(cgh);
+
+     cgh.parallel_for(
+       range<2>(t.nz, t.ny), sum_red, [=](id<2> id, auto &sum) {
+         const size_t k = id[0] + 1;
+         const size_t j = id[1] + 1;
+
+         double row_sum = 0.0;
+         // running compensation for the low-order bits lost in row_sum
+         double c = 0.0;
+         for (int i = 1; i < t.nx + 1; i++) {
+           const double y  = values(k, j, i) - c;
+           const double tt = row_sum + y;
+           c               = (tt - row_sum) - y;
+           row_sum         = tt;
+         }
+         sum += row_sum;
+       });
+   }).wait();
+
+  Q.copy(d_sum, &sum, 1).wait();
+  free(d_sum, Q);
+
+  return sum;
+}
+
+// Calculate average temperature over the non-boundary grid cells
+double
+average(queue &Q, buffer<double, 3> &data)
+{
+  field t;
+  t.nz = data.get_range()[0] - 2;
+  t.ny = data.get_range()[1] - 2;
+  t.nx = data.get_range()[2] - 2;
+
+  auto sum = interior_sum(Q, t, [&](handler &cgh) {
+    auto acc = accessor(data, cgh, read_only);
+    return [=](size_t k, size_t j, size_t i) {
+      return acc[k][j][i];
+    };
+  });
+
+  return sum / (static_cast<double>(t.nx) * t.ny * t.nz);
+}
+
+// Calculate average temperature over the non-boundary grid cells of a field
+// in a USM device allocation
+double
+average(queue &Q, const field *temperature, const double *data)
+{
+  const auto t = *temperature;
+
+  auto sum = interior_sum(Q, t, [=](handler &) {
+    return [=](size_t k, size_t j, size_t i) {
+      return data[field_index(t, k, j, i)];
+    };
+  });
+
+  return sum / (static_cast<double>(t.nx) * t.ny * t.nz);
+}
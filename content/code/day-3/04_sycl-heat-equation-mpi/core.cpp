@@ -0,0 +1,118 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Main solver routines for heat equation solver
+
+#include <algorithm>
+
+#include <sycl/sycl.hpp>
+
+#include "heat.h"
+
+using namespace sycl;
+
+// Explicit update of the grid point c, ld being the length of the rows
+static inline void
+update(
+  double *curr,
+  const double *prev,
+  int c,
+  int ld,
+  double a,
+  double dt,
+  double dx2,
+  double dy2)
+{
+  curr[c] =
+    prev[c] +
+    a * dt *
+      ((prev[c + ld] - 2.0 * prev[c] + prev[c - ld]) / dx2 +
+       (prev[c + 1] - 2.0 * prev[c] + prev[c - 1]) / dy2);
+}
+
+// Update the points of the local field that do not need the ghost layers,
+// that is all but the first and last rows and columns. The kernel is
+// independent of the halo exchange of prev, so it runs while the messages
+// are in flight.
+event
+evolve_interior(
+  queue &Q,
+  double *curr,
+  const double *prev,
+  const field *layout,
+  double a,
+  double dt)
+{
+  int ld     = layout->ny + 2;
+  double dx2 = layout->dx * layout->dx;
+  double dy2 = layout->dy * layout->dy;
+
+  range<2> interior { static_cast<size_t>(std::max(layout->nx - 2, 0)),
+                      static_cast<size_t>(std::max(layout->ny - 2, 0)) };
+
+  return Q.parallel_for(interior, [=](id<2> id) {
+    int i = id[0] + 2;
+    int j = id[1] + 2;
+    update(curr, prev, i * ld + j, ld, a, dt, dx2, dy2);
+  });
+}
+
+// Update the first and last rows and columns of the local field, once the
+// ghost layers of prev have been filled by the event ghosts. The points are
+// enumerated as the two rows followed by the two columns without their
+// ends, and with a single row or column the same points are updated twice
+// to the same value.
+event
+evolve_edges(
+  queue &Q,
+  double *curr,
+  const double *prev,
+  const field *layout,
+  double a,
+  double dt,
+  event ghosts)
+{
+  int nx     = layout->nx;
+  int ny     = layout->ny;
+  int ld     = ny + 2;
+  double dx2 = layout->dx * layout->dx;
+  double dy2 = layout->dy * layout->dy;
+
+  int ncolumn    = std::max(nx - 2, 0);
+  size_t npoints = 2 * ny + 2 * ncolumn;
+
+  return Q.submit([&](handler &h) {
+    h.depends_on(ghosts);
+    h.parallel_for(range<1>(npoints), [=](id<1> id) {
+      int k = id[0];
+      int i, j;
+      if (k < 2 * ny) {
+        i = k < ny ? 1 : nx;
+        j = k % ny + 1;
+      } else {
+        k -= 2 * ny;
+        i = k % ncolumn + 2;
+        j = k < ncolumn ? 1 : ny;
+      }
+      update(curr, prev, i * ld + j, ld, a, dt, dx2, dy2);
+    });
+  });
+}
@@ -0,0 +1,160 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#pragma once
+
+#include <mpi.h>
+#include <vector>
+
+#include <sycl/sycl.hpp>
+
+// Datatype for the part of the temperature field owned by one MPI task
+struct field
+{
+  // nx and ny are the dimensions of the local part of the field. The array
+  // data contains also ghost layers, so it will have dimensions nx+2 x ny+2
+  int nx;
+  int ny;
+  // Dimensions of the whole field
+  int nx_full;
+  int ny_full;
+  // Size of the grid cells
+  double dx;
+  double dy;
+  // The temperature values in the local part of the 2D grid
+  std::vector<double> data;
+};
+
+// Parallelization info: the field is split into blocks over a 2D Cartesian
+// grid of MPI tasks, the first dimension of the task grid going along the
+// rows of the field
+struct parallel_data
+{
+  int size;
+  int rank;
+  // Communicator with the Cartesian topology
+  MPI_Comm comm;
+  // Number of tasks along both dimensions, and the coordinates of this task
+  int dims[2];
+  int coords[2];
+  // Ranks of the neighbouring tasks, MPI_PROC_NULL at the edges of the grid
+  int nup, ndown, nleft, nright;
+};
+
+// State of a halo exchange. The edges of the local field are staged in
+// host memory on both sides of the messages, in the order: row up, row
+// down, column left, column right.
+struct halo_exchange
+{
+  double *send;
+  double *recv;
+  MPI_Request requests[8];
+};
+
+// Constants used in the solver
+constexpr auto DX = 0.01;
+constexpr auto DY = 0.01;
+
+// Function declarations
+void
+initialize(
+  int argc,
+  char *argv[],
+  field *current,
+  field *previous,
+  int *nsteps,
+  parallel_data *parallel);
+
+void
+parallel_setup(parallel_data *parallel, int nx_full, int ny_full);
+
+void
+set_field_dimensions(
+  field *temperature,
+  int nx_full,
+  int ny_full,
+  const parallel_data *parallel);
+
+void
+generate_field(field *temperature, const parallel_data *parallel);
+
+void
+allocate_halo_exchange(
+  sycl::queue &Q,
+  const field *temperature,
+  halo_exchange *halo);
+
+void
+free_halo_exchange(sycl::queue &Q, halo_exchange *halo);
+
+void
+start_halo_exchange(
+  sycl::queue &Q,
+  const double *prev,
+  const field *layout,
+  const parallel_data *parallel,
+  halo_exchange *halo);
+
+sycl::event
+finish_halo_exchange(
+  sycl::queue &Q,
+  double *prev,
+  const field *layout,
+  const parallel_data *parallel,
+  halo_exchange *halo);
+
+sycl::event
+evolve_interior(
+  sycl::queue &Q,
+  double *curr,
+  const double *prev,
+  const field *layout,
+  double a,
+  double dt);
+
+sycl::event
+evolve_edges(
+  sycl::queue &Q,
+  double *curr,
+  const double *prev,
+  const field *layout,
+  double a,
+  double dt,
+  sycl::event ghosts);
+
+double *
+allocate_device_field(sycl::queue &Q, const field *temperature);
+
+void
+copy_field_from_device(sycl::queue &Q, const double *data, field *temperature);
+
+double
+average(
+  sycl::queue &Q,
+  const double *data,
+  const field *layout,
+  const parallel_data *parallel);
+
+void
+write_field(const field *temperature, int iter, const parallel_data *parallel);
+
+int
+parameter_from_env(const char *name, int fallback);
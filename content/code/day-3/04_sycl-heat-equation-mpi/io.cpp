@@ -0,0 +1,88 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// I/O related functions for heat equation solver
+
+#include <cstdio>
+
+#include "heat.h"
+
+// Output routine that writes out the temperature distribution of the whole
+// field with MPI-IO. All tasks write their local part, without the ghost
+// layers, to the same file in a collective call. The file holds the
+// nx_full x ny_full values in row-major order as raw doubles in the native
+// representation.
+void
+write_field(const field *temperature, int iter, const parallel_data *parallel)
+{
+  char filename[64];
+  sprintf(filename, "%s_%04d.dat", "heat", iter);
+
+  // The local part as seen in the memory, with the ghost layers...
+  int local_sizes[2]    = { temperature->nx + 2, temperature->ny + 2 };
+  int local_subsizes[2] = { temperature->nx, temperature->ny };
+  int local_starts[2]   = { 1, 1 };
+  MPI_Datatype memory_type;
+  MPI_Type_create_subarray(
+    2,
+    local_sizes,
+    local_subsizes,
+    local_starts,
+    MPI_ORDER_C,
+    MPI_DOUBLE,
+    &memory_type);
+  MPI_Type_commit(&memory_type);
+
+  // ...and as seen in the file
+  int sizes[2]  = { temperature->nx_full, temperature->ny_full };
+  int starts[2] = { parallel->coords[0] * temperature->nx,
+                    parallel->coords[1] * temperature->ny };
+  MPI_Datatype file_type;
+  MPI_Type_create_subarray(
+    2,
+    sizes,
+    local_subsizes,
+    starts,
+    MPI_ORDER_C,
+    MPI_DOUBLE,
+    &file_type);
+  MPI_Type_commit(&file_type);
+
+  MPI_File file;
+  MPI_File_open(
+    parallel->comm,
+    filename,
+    MPI_MODE_CREATE | MPI_MODE_WRONLY,
+    MPI_INFO_NULL,
+    &file);
+  // Drop whatever an earlier run with a larger grid left past the end
+  MPI_File_set_size(
+    file,
+    static_cast<MPI_Offset>(sizeof(double)) * temperature->nx_full *
+      temperature->ny_full);
+  MPI_File_set_view(file, 0, MPI_DOUBLE, file_type, "native", MPI_INFO_NULL);
+  MPI_File_write_all(
+    file, temperature->data.data(), 1, memory_type, MPI_STATUS_IGNORE);
+  MPI_File_close(&file);
+
+  MPI_Type_free(&memory_type);
+  MPI_Type_free(&file_type);
+}
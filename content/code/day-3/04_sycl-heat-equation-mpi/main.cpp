@@ -0,0 +1,135 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Main routine for heat equation solver in 2D, distributed over MPI tasks.
+
+#include <chrono>
+#include <cstdio>
+
+#include <sycl/sycl.hpp>
+
+#include "heat.h"
+
+using namespace sycl;
+
+int
+main(int argc, char **argv)
+{
+  MPI_Init(&argc, &argv);
+
+  // Image output interval
+  int image_interval = 1500;
+
+  // Number of time steps
+  int nsteps;
+  // Current and previous temperature fields
+  field current, previous;
+  // Decomposition of the field over the tasks
+  parallel_data parallel;
+  initialize(argc, argv, &current, &previous, &nsteps, &parallel);
+
+  // Output the initial field
+  write_field(&current, 0, &parallel);
+
+  // Out-of-order queue: the interior and the edges of the field are
+  // updated by separate kernels ordered through events
+  queue Q;
+
+  // Local parts of the fields in device memory
+  double *d_curr = allocate_device_field(Q, &current);
+  double *d_prev = allocate_device_field(Q, &previous);
+
+  halo_exchange halo;
+  allocate_halo_exchange(Q, &current, &halo);
+
+  double average_temp = average(Q, d_curr, &current, &parallel);
+  if (parallel.rank == 0) {
+    printf(
+      "Running on %d x %d MPI tasks, %d x %d grid points each\n",
+      parallel.dims[0],
+      parallel.dims[1],
+      current.nx,
+      current.ny);
+    printf("Average temperature at start: %f\n", average_temp);
+  }
+
+  // Diffusion constant
+  double a = 0.5;
+
+  // Compute the largest stable time step
+  double dx2 = current.dx * current.dx;
+  double dy2 = current.dy * current.dy;
+  // Time step
+  double dt = dx2 * dy2 / (2.0 * a * (dx2 + dy2));
+
+  using wall_clock_t = std::chrono::high_resolution_clock;
+
+  MPI_Barrier(parallel.comm);
+  auto start = wall_clock_t::now();
+
+  // Time evolve
+  for (int iter = 1; iter <= nsteps; iter++) {
+    // The messages are in flight while the device updates the interior,
+    // and the edges follow once the ghost layers have arrived
+    start_halo_exchange(Q, d_prev, &previous, &parallel, &halo);
+    auto interior = evolve_interior(Q, d_curr, d_prev, &current, a, dt);
+    auto ghosts = finish_halo_exchange(Q, d_prev, &previous, &parallel, &halo);
+    auto edges  = evolve_edges(Q, d_curr, d_prev, &current, a, dt, ghosts);
+    interior.wait();
+    edges.wait();
+
+    if (iter % image_interval == 0) {
+      copy_field_from_device(Q, d_curr, &current);
+      write_field(&current, iter, &parallel);
+    }
+    // Swap current field so that it will be used
+    // as previous for next iteration step
+    std::swap(d_curr, d_prev);
+  }
+
+  MPI_Barrier(parallel.comm);
+  auto stop = wall_clock_t::now();
+
+  // Average temperature for reference
+  average_temp = average(Q, d_prev, &previous, &parallel);
+
+  // Determine the CPU time used for all the iterations
+  std::chrono::duration<float> elapsed = stop - start;
+  if (parallel.rank == 0) {
+    printf("Iterations took %.3f seconds.\n", elapsed.count());
+    printf("Average temperature: %f\n", average_temp);
+    if (argc == 1) {
+      printf("Reference value with default arguments: 59.281239\n");
+    }
+  }
+
+  // Output the final field
+  copy_field_from_device(Q, d_prev, &previous);
+  write_field(&previous, nsteps, &parallel);
+
+  free_halo_exchange(Q, &halo);
+  free(d_curr, Q);
+  free(d_prev, Q);
+
+  MPI_Finalize();
+
+  return 0;
+}
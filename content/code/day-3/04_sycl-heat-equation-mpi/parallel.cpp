@@ -0,0 +1,145 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Halo exchange between the MPI tasks
+
+#include <sycl/sycl.hpp>
+
+#include "heat.h"
+
+using namespace sycl;
+
+// Allocate the host staging buffers for the edges of temperature
+void
+allocate_halo_exchange(queue &Q, const field *temperature, halo_exchange *halo)
+{
+  size_t count = 2 * (temperature->nx + temperature->ny);
+  halo->send   = malloc_host<double>(count, Q);
+  halo->recv   = malloc_host<double>(count, Q);
+}
+
+void
+free_halo_exchange(queue &Q, halo_exchange *halo)
+{
+  free(halo->send, Q);
+  free(halo->recv, Q);
+}
+
+// Copy the first and last rows and columns of prev to the send buffer, and
+// post the messages to and from the four neighbours. The messages to
+// neighbours outside the grid are null operations, which keeps the ghost
+// layers holding the boundary conditions as they are.
+void
+start_halo_exchange(
+  queue &Q,
+  const double *prev,
+  const field *layout,
+  const parallel_data *parallel,
+  halo_exchange *halo)
+{
+  int nx       = layout->nx;
+  int ny       = layout->ny;
+  int ld       = ny + 2;
+  double *send = halo->send;
+
+  Q.parallel_for(range<1>(std::max(nx, ny)), [=](id<1> id) {
+    int k = id[0];
+    if (k < ny) {
+      send[k]      = prev[ld + k + 1];
+      send[ny + k] = prev[nx * ld + k + 1];
+    }
+    if (k < nx) {
+      send[2 * ny + k]      = prev[(k + 1) * ld + 1];
+      send[2 * ny + nx + k] = prev[(k + 1) * ld + ny];
+    }
+  }).wait();
+
+  // Offsets of the rows and columns in the staging buffers
+  int offset[4]    = { 0, ny, 2 * ny, 2 * ny + nx };
+  int count[4]     = { ny, ny, nx, nx };
+  int neighbour[4] = { parallel->nup,
+                       parallel->ndown,
+                       parallel->nleft,
+                       parallel->nright };
+  // The edge sent to a neighbour is received into the opposite ghost layer
+  // there, so the tag names the direction of travel
+  for (int side = 0; side < 4; side++) {
+    MPI_Irecv(
+      halo->recv + offset[side],
+      count[side],
+      MPI_DOUBLE,
+      neighbour[side],
+      side ^ 1,
+      parallel->comm,
+      &halo->requests[side]);
+    MPI_Isend(
+      send + offset[side],
+      count[side],
+      MPI_DOUBLE,
+      neighbour[side],
+      side,
+      parallel->comm,
+      &halo->requests[4 + side]);
+  }
+}
+
+// Wait for the messages posted by start_halo_exchange, and copy the
+// received edges to the ghost layers of prev. The returned event marks the
+// ghost layers ready.
+event
+finish_halo_exchange(
+  queue &Q,
+  double *prev,
+  const field *layout,
+  const parallel_data *parallel,
+  halo_exchange *halo)
+{
+  MPI_Waitall(8, halo->requests, MPI_STATUSES_IGNORE);
+
+  int nx             = layout->nx;
+  int ny             = layout->ny;
+  int ld             = ny + 2;
+  const double *recv = halo->recv;
+  bool up            = parallel->nup != MPI_PROC_NULL;
+  bool down          = parallel->ndown != MPI_PROC_NULL;
+  bool left          = parallel->nleft != MPI_PROC_NULL;
+  bool right         = parallel->nright != MPI_PROC_NULL;
+
+  return Q.parallel_for(range<1>(std::max(nx, ny)), [=](id<1> id) {
+    int k = id[0];
+    if (k < ny) {
+      if (up) {
+        prev[k + 1] = recv[k];
+      }
+      if (down) {
+        prev[(nx + 1) * ld + k + 1] = recv[ny + k];
+      }
+    }
+    if (k < nx) {
+      if (left) {
+        prev[(k + 1) * ld] = recv[2 * ny + k];
+      }
+      if (right) {
+        prev[(k + 1) * ld + ny + 1] = recv[2 * ny + nx + k];
+      }
+    }
+  });
+}
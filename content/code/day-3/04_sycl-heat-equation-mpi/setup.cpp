@@ -0,0 +1,199 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/* Setup routines for heat equation solver */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include "heat.h"
+
+// Default number of iteration steps
+constexpr auto NSTEPS = 500;
+
+/* Initialize the heat equation solver */
+void
+initialize(
+  int argc,
+  char *argv[],
+  field *current,
+  field *previous,
+  int *nsteps,
+  parallel_data *parallel)
+{
+  /*
+   * Following combinations of command line arguments are possible:
+   * No arguments:    use default field dimensions and number of time steps
+   * Three arguments: field dimensions (rows,cols) and number of time steps
+   */
+
+  int rows = 2000; //!< Field dimensions with default values
+  int cols = 2000;
+
+  *nsteps = NSTEPS;
+
+  switch (argc) {
+    case 1:
+      /* Use default values */
+      break;
+    case 4:
+      /* Field dimensions */
+      rows = atoi(argv[1]);
+      cols = atoi(argv[2]);
+      /* Number of time steps */
+      *nsteps = atoi(argv[3]);
+      break;
+    default:
+      printf("Unsupported number of command line arguments\n");
+      MPI_Abort(MPI_COMM_WORLD, -1);
+  }
+
+  parallel_setup(parallel, rows, cols);
+  set_field_dimensions(current, rows, cols, parallel);
+  set_field_dimensions(previous, rows, cols, parallel);
+  generate_field(current, parallel);
+  previous->data = current->data;
+}
+
+/* Arrange the MPI tasks in a 2D Cartesian grid. The grid is chosen by
+ * MPI_Dims_create unless set in the environment variables HEAT_TASKS_X
+ * (tasks along the rows) and HEAT_TASKS_Y, and it has to divide the field
+ * evenly. */
+void
+parallel_setup(parallel_data *parallel, int nx_full, int ny_full)
+{
+  int world_size;
+  MPI_Comm_size(MPI_COMM_WORLD, &world_size);
+
+  parallel->dims[0] = parameter_from_env("HEAT_TASKS_X", 0);
+  parallel->dims[1] = parameter_from_env("HEAT_TASKS_Y", 0);
+  MPI_Dims_create(world_size, 2, parallel->dims);
+
+  if (nx_full % parallel->dims[0] || ny_full % parallel->dims[1]) {
+    printf(
+      "Unable to divide the %d x %d grid over %d x %d tasks\n",
+      nx_full,
+      ny_full,
+      parallel->dims[0],
+      parallel->dims[1]);
+    MPI_Abort(MPI_COMM_WORLD, -2);
+  }
+
+  int periods[2] = { 0, 0 };
+  MPI_Cart_create(
+    MPI_COMM_WORLD, 2, parallel->dims, periods, 1, &parallel->comm);
+  MPI_Comm_size(parallel->comm, &parallel->size);
+  MPI_Comm_rank(parallel->comm, &parallel->rank);
+  MPI_Cart_coords(parallel->comm, parallel->rank, 2, parallel->coords);
+  MPI_Cart_shift(parallel->comm, 0, 1, &parallel->nup, &parallel->ndown);
+  MPI_Cart_shift(parallel->comm, 1, 1, &parallel->nleft, &parallel->nright);
+}
+
+/* Generate initial temperature field.  Pattern is disc with a radius
+ * of nx_full / 6 in the center of the whole grid.
+ * Boundary conditions are (different) constant temperatures outside the
+ * grid, set in the ghost layers of the tasks at the edges of the grid */
+void
+generate_field(field *temperature, const parallel_data *parallel)
+{
+  int ind;
+  double radius;
+  int dx, dy;
+
+  /* Allocate the temperature array, note that
+   * we have to allocate also the ghost layers */
+  int newSize = (temperature->nx + 2) * (temperature->ny + 2);
+  temperature->data.resize(newSize, 0.0);
+
+  /* Offset of the local part in the whole grid */
+  int i0 = parallel->coords[0] * temperature->nx;
+  int j0 = parallel->coords[1] * temperature->ny;
+
+  /* Radius of the source disc */
+  radius = temperature->nx_full / 6.0;
+  for (int i = 0; i < temperature->nx + 2; i++) {
+    for (int j = 0; j < temperature->ny + 2; j++) {
+      ind = i * (temperature->ny + 2) + j;
+      /* Distance of point i, j from the origin */
+      dx = i0 + i - temperature->nx_full / 2 + 1;
+      dy = j0 + j - temperature->ny_full / 2 + 1;
+      if (dx * dx + dy * dy < radius * radius) {
+        temperature->data[ind] = 5.0;
+      } else {
+        temperature->data[ind] = 65.0;
+      }
+    }
+  }
+
+  /* Boundary conditions */
+  if (parallel->nleft == MPI_PROC_NULL) {
+    for (int i = 0; i < temperature->nx + 2; i++) {
+      temperature->data[i * (temperature->ny + 2)] = 20.0;
+    }
+  }
+  if (parallel->nright == MPI_PROC_NULL) {
+    for (int i = 0; i < temperature->nx + 2; i++) {
+      temperature->data[i * (temperature->ny + 2) + temperature->ny + 1] = 70.0;
+    }
+  }
+
+  if (parallel->nup == MPI_PROC_NULL) {
+    for (int j = 0; j < temperature->ny + 2; j++) {
+      temperature->data[j] = 85.0;
+    }
+  }
+  if (parallel->ndown == MPI_PROC_NULL) {
+    for (int j = 0; j < temperature->ny + 2; j++) {
+      temperature->data[(temperature->nx + 1) * (temperature->ny + 2) + j] =
+        5.0;
+    }
+  }
+}
+
+/* Set dimensions of the field. Note that the nx is the size of the first
+ * dimension and ny the second. The local dimensions follow from the
+ * dimensions of the whole field and the task grid. */
+void
+set_field_dimensions(
+  field *temperature,
+  int nx_full,
+  int ny_full,
+  const parallel_data *parallel)
+{
+  temperature->dx      = DX;
+  temperature->dy      = DY;
+  temperature->nx_full = nx_full;
+  temperature->ny_full = ny_full;
+  temperature->nx      = nx_full / parallel->dims[0];
+  temperature->ny      = ny_full / parallel->dims[1];
+}
+
+/* Read an integer tuning parameter from the environment variable name.
+ * The fallback value is returned if the variable is not set. */
+int
+parameter_from_env(const char *name, int fallback)
+{
+  const char *value = getenv(name);
+  if (value == nullptr) {
+    return fallback;
+  }
+  return atoi(value);
+}
@@ -0,0 +1,74 @@
+/* Copyright (c) 2021 CSC
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Utility functions for heat equation solver
+
+#include <sycl/sycl.hpp>
+
+#include "heat.h"
+
+using namespace sycl;
+
+// Allocate the local part of the field, with the ghost layers, in device
+// memory and copy the values of temperature there
+double *
+allocate_device_field(queue &Q, const field *temperature)
+{
+  double *data = malloc_device<double>(temperature->data.size(), Q);
+  Q.copy(temperature->data.data(), data, temperature->data.size()).wait();
+  return data;
+}
+
+// Copy the local part of the field from device memory to temperature
+void
+copy_field_from_device(queue &Q, const double *data, field *temperature)
+{
+  Q.copy(data, temperature->data.data(), temperature->data.size()).wait();
+}
+
+// Average temperature over the whole field. Each task sums its local part
+// on the device, and the sums are combined over the tasks.
+double
+average(
+  queue &Q,
+  const double *data,
+  const field *layout,
+  const parallel_data *parallel)
+{
+  int ld = layout->ny + 2;
+  range<2> local { static_cast<size_t>(layout->nx),
+                   static_cast<size_t>(layout->ny) };
+
+  double *sum = malloc_shared<double>(1, Q);
+  *sum        = 0.0;
+  Q.submit([&](handler &h) {
+     h.parallel_for(
+       local, reduction(sum, plus<double>()), [=](id<2> id, auto &sum) {
+         sum += data[(id[0] + 1) * ld + id[1] + 1];
+       });
+   }).wait();
+
+  double local_sum = *sum, total = 0.0;
+  free(sum, Q);
+  MPI_Allreduce(&local_sum, &total, 1, MPI_DOUBLE, MPI_SUM, parallel->comm);
+
+  return total / (layout->nx_full * static_cast<double>(layout->ny_full));
+}